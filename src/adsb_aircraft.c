@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <string.h>
+#include "adsb_aircraft.h"
+#include "adsb_time.h"
+#include "adsb_createLog.h"
+
+/*==================================
+STRUCT: aircraftSlot
+DESCRIPTION:
+	uint32_t address: the address of the node, kept in the
+		slot so a probe doesn't touch the node.
+	adsbMsg *node: the aircraft, NULL for an empty slot.
+===================================*/
+typedef struct{
+	uint32_t address;
+	adsbMsg *node;
+}aircraftSlot;
+
+//The hot records must stay in one cache line (see adsbMsg)
+_Static_assert(sizeof(adsbMsg) == 64, "adsbMsg must fit in 64 bytes");
+
+static adsbMsg *pool = NULL;		//the aircraft records, allocated at once
+static adsbCold *coldPool = NULL;	//their cold part, at the same index
+static adsbMsg *freeNodes = NULL;	//records not in use, chained by next
+static int poolCapacity = AIRCRAFT_DEFAULT_CAPACITY;
+static aircraftSlot *slots = NULL;
+static int slotBits = 0;			//log2 of the number of slots
+static adsbMsg *oldest = NULL;		//least recently updated, start of the chain
+static adsbMsg *newest = NULL;		//most recently updated, end of the chain
+static aircraftStats stats;
+
+/*==============================================
+FUNCTION: AIRCRAFT_hash
+INPUT: a 24-bit address
+OUTPUT: its home slot
+DESCRIPTION: multiplicative hash, as the addresses
+of a country are allocated in blocks.
+================================================*/
+static inline unsigned AIRCRAFT_hash(uint32_t address){
+	return (address * 2654435761u) >> (32 - slotBits);
+}
+
+/*==============================================
+FUNCTION: findSlot
+INPUT: a 24-bit address
+OUTPUT: the slot of the address, or the empty slot
+where it would be inserted
+DESCRIPTION: linear probing. The table has twice
+as many slots as the pool has records, so an empty slot is always
+reached within a few probes.
+================================================*/
+static aircraftSlot* findSlot(uint32_t address){
+	unsigned mask = (1u << slotBits) - 1;
+	unsigned i = AIRCRAFT_hash(address);
+
+	stats.lookups++;
+	for(;;){
+		stats.probes++;
+		if((slots[i].node == NULL) || (slots[i].address == address)){
+			return &slots[i];
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+//The links of the chain are pool index + 1, 0 for none
+static inline adsbMsg* nodeAt(uint32_t link){
+	return link ? &pool[link - 1] : NULL;
+}
+
+static inline uint32_t linkOf(const adsbMsg *node){
+	return node ? (uint32_t)(node - pool) + 1 : 0;
+}
+
+static void chainRemove(adsbMsg *node){
+	adsbMsg *prev = nodeAt(node->prev), *next = nodeAt(node->next);
+
+	if(prev){
+		prev->next = node->next;
+	}else{
+		oldest = next;
+	}
+	if(next){
+		next->prev = node->prev;
+	}else{
+		newest = prev;
+	}
+}
+
+static void chainAppend(adsbMsg *node){
+	node->prev = linkOf(newest);
+	node->next = 0;
+	if(newest){
+		newest->next = linkOf(node);
+	}else{
+		oldest = node;
+	}
+	newest = node;
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_init
+INPUT: the number of aircraft records
+OUTPUT: AIRCRAFT_OK or AIRCRAFT_ERROR
+DESCRIPTION: allocates the pool of records (hot and
+cold parts) and the hash table, with at least twice as many slots, and
+chains all the records as free. Nothing else is
+allocated afterwards. If it isn't called, the first
+AIRCRAFT_add() does it with the last capacity set
+(AIRCRAFT_DEFAULT_CAPACITY at first).
+================================================*/
+int AIRCRAFT_init(int capacity){
+	int bits = 1, i = 0;
+
+	if(capacity < 1){
+		return AIRCRAFT_ERROR;
+	}
+	AIRCRAFT_clear();
+	while((1 << bits) < 2 * capacity){
+		bits++;
+	}
+
+	pool = (adsbMsg*)aligned_alloc(sizeof(adsbMsg), capacity * sizeof(adsbMsg));
+	coldPool = (adsbCold*)calloc(capacity, sizeof(adsbCold));
+	slots = (aircraftSlot*)calloc((size_t)1 << bits, sizeof(aircraftSlot));
+	if((pool == NULL) || (coldPool == NULL) || (slots == NULL)){
+		LOG_add("AIRCRAFT_init", "aircraft pool couldn't be allocated");
+		AIRCRAFT_clear();
+		return AIRCRAFT_ERROR;
+	}
+	memset(pool, 0, capacity * sizeof(adsbMsg));
+	for(i = 0; i < capacity - 1; i++){
+		pool[i].next = i + 2;
+	}
+	freeNodes = &pool[0];
+
+	poolCapacity = capacity;
+	slotBits = bits;
+	stats.capacity = capacity;
+	stats.slots = 1 << bits;
+	return AIRCRAFT_OK;
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_find
+INPUT: a 24-bit address
+OUTPUT: the node of the aircraft or NULL
+================================================*/
+adsbMsg* AIRCRAFT_find(uint32_t address){
+	if(slots == NULL){
+		return NULL;
+	}
+	return findSlot(address)->node;
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_add
+INPUT: a 24-bit address and the current time
+OUTPUT: the new node, or NULL if the address is
+already in the table or there is no memory
+DESCRIPTION: takes a record from the pool for an
+aircraft, as the most recently updated one. The
+record and its cold part are zeroed at once, so
+every field starts at 0. If the pool is exhausted, the least recently
+updated aircraft is dropped to make room.
+================================================*/
+adsbMsg* AIRCRAFT_add(uint32_t address, double now){
+	aircraftSlot *slot = NULL;
+	adsbMsg *msg = NULL;
+
+	if((slots == NULL) && (AIRCRAFT_init(poolCapacity) != AIRCRAFT_OK)){
+		return NULL;
+	}
+
+	slot = findSlot(address);
+	if(slot->node != NULL){
+		return NULL;
+	}
+	if(freeNodes == NULL){
+		AIRCRAFT_remove(oldest);
+		stats.recycled++;
+		slot = findSlot(address);		//the removal may have shifted the slots
+	}
+	msg = freeNodes;
+	freeNodes = nodeAt(msg->next);
+
+	memset(msg, 0, sizeof(adsbMsg));
+	memset(&coldPool[msg - pool], 0, sizeof(adsbCold));
+	msg->address = address;
+	msg->uptadeTime = TIME_toTicks(now);
+
+	slot->address = address;
+	slot->node = msg;
+	chainAppend(msg);
+
+	stats.added++;
+	if(++stats.count > stats.highWater){
+		stats.highWater = stats.count;
+	}
+	return msg;
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_touch
+INPUT: a node and the current time
+OUTPUT: void
+DESCRIPTION: marks the node as updated now, moving
+it to the end of the chain.
+================================================*/
+void AIRCRAFT_touch(adsbMsg *node, double now){
+	node->uptadeTime = TIME_toTicks(now);
+	if(node != newest){
+		chainRemove(node);
+		chainAppend(node);
+	}
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_remove
+INPUT: a node of the table
+OUTPUT: void
+DESCRIPTION: gives the node back to the pool. The
+slots after the one of the node are shifted back
+while they are not in their home position, so no
+deleted markers are needed and the probe sequences
+stay short.
+================================================*/
+void AIRCRAFT_remove(adsbMsg *node){
+	unsigned mask = (1u << slotBits) - 1;
+	unsigned hole = (unsigned)(findSlot(node->address) - slots);
+	unsigned i = hole;
+
+	for(;;){
+		unsigned home = 0;
+
+		i = (i + 1) & mask;
+		if(slots[i].node == NULL){
+			break;
+		}
+		home = AIRCRAFT_hash(slots[i].address);
+		//the entry can fill the hole if its home isn't cyclically in (hole, i]
+		if(((i - home) & mask) >= ((i - hole) & mask)){
+			slots[hole] = slots[i];
+			hole = i;
+		}
+	}
+	slots[hole].node = NULL;
+
+	chainRemove(node);
+	node->next = linkOf(freeNodes);
+	freeNodes = node;
+	stats.count--;
+	stats.removed++;
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_expire
+INPUT: the current time and the idle time, in s
+OUTPUT: the number of aircraft expired
+DESCRIPTION: removes the aircraft not updated for
+more than the idle time. The chain is ordered by
+the last update, so they are all at its start and
+the search stops at the first recent one: a call
+costs O(1) plus O(1) per aircraft removed, and can
+be made as often as wanted.
+================================================*/
+int AIRCRAFT_expire(double now, double idle){
+	uint32_t ticks = TIME_toTicks(now);
+	int expired = 0;
+
+	while((oldest != NULL) && (TIME_elapsed(oldest->uptadeTime, ticks) > idle)){
+		AIRCRAFT_remove(oldest);
+		expired++;
+	}
+	stats.expired += expired;
+	return expired;
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_clear
+INPUT: void
+OUTPUT: void
+DESCRIPTION: frees the pool and the table, with
+all the aircraft.
+================================================*/
+void AIRCRAFT_clear(void){
+	free(pool);
+	free(coldPool);
+	free(slots);
+	pool = NULL;
+	coldPool = NULL;
+	slots = NULL;
+	freeNodes = NULL;
+	oldest = NULL;
+	newest = NULL;
+	stats.removed += stats.count;
+	stats.count = 0;
+}
+
+adsbMsg* AIRCRAFT_oldest(void){
+	return oldest;
+}
+
+adsbMsg* AIRCRAFT_newest(void){
+	return newest;
+}
+
+//The aircraft updated after 'node', NULL for the newest
+adsbMsg* AIRCRAFT_newer(const adsbMsg *node){
+	return nodeAt(node->next);
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_cold
+INPUT: a node of the table
+OUTPUT: its cold part
+================================================*/
+adsbCold* AIRCRAFT_cold(const adsbMsg *node){
+	return &coldPool[node - pool];
+}
+
+/*==============================================
+FUNCTION: AIRCRAFT_getStats
+INPUT: a pointer to aircraftStats
+OUTPUT: the counters, passed by reference
+================================================*/
+void AIRCRAFT_getStats(aircraftStats *out){
+	*out = stats;
+}
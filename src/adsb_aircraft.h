@@ -0,0 +1,80 @@
+#ifndef ADSB_AIRCRAFT_H
+#define ADSB_AIRCRAFT_H
+
+#include <stdint.h>
+#include "adsb_lists.h"
+
+/*===============================
+These functions keep the state of
+the aircraft being tracked (one
+adsbMsg per aircraft). The nodes
+are found by their 24-bit address
+in an open addressing hash table
+and are also chained from the
+least to the most recently updated
+one (next/prev), so an update moves
+its node to the end and the stale
+aircraft are at the start, both in
+constant time. The nodes come from
+a pool allocated once, whose size is
+set at startup, and their cold part
+(adsbCold) from a second pool at
+the same index; when it is exhausted
+the least recently updated aircraft
+is recycled. The aircraft not updated
+for a while are expired from the
+start of the chain. The LIST_* functions
+are adapters over this table.
+=================================*/
+
+#define AIRCRAFT_DEFAULT_CAPACITY  4096    // aircraft records of the pool
+#define AIRCRAFT_DEFAULT_IDLE      60      // s without an update before an aircraft is expired
+
+//Status Macros
+#define AIRCRAFT_ERROR -1
+#define AIRCRAFT_OK     0
+
+/*==================================
+STRUCT: aircraftStats
+DESCRIPTION:
+	int count: aircraft in the table.
+	int highWater: most aircraft in the table at once. Once it
+		reaches capacity, the memory used doesn't grow anymore.
+	int capacity: aircraft records of the pool.
+	int slots: slots of the hash table (at least twice capacity).
+	unsigned long added, removed: nodes taken from and given back
+		to the pool.
+	unsigned long recycled: aircraft dropped because the pool was
+		exhausted (included in removed).
+	unsigned long expired: aircraft dropped because they weren't
+		updated for the idle time (included in removed).
+	unsigned long lookups: searches by address.
+	unsigned long probes: slots examined by the searches.
+===================================*/
+typedef struct{
+	int count;
+	int highWater;
+	int capacity;
+	int slots;
+	unsigned long added;
+	unsigned long removed;
+	unsigned long recycled;
+	unsigned long expired;
+	unsigned long lookups;
+	unsigned long probes;
+}aircraftStats;
+
+int      AIRCRAFT_init(int capacity);
+adsbMsg* AIRCRAFT_find(uint32_t address);
+adsbMsg* AIRCRAFT_add(uint32_t address, double now);
+void     AIRCRAFT_touch(adsbMsg *node, double now);
+void     AIRCRAFT_remove(adsbMsg *node);
+int      AIRCRAFT_expire(double now, double idle);
+void     AIRCRAFT_clear(void);
+adsbMsg* AIRCRAFT_oldest(void);
+adsbMsg* AIRCRAFT_newest(void);
+adsbMsg* AIRCRAFT_newer(const adsbMsg *node);
+adsbCold* AIRCRAFT_cold(const adsbMsg *node);
+void     AIRCRAFT_getStats(aircraftStats *stats);
+
+#endif
@@ -2,6 +2,8 @@
 #include <string.h>
 #include <math.h>
 #include "adsb_auxiliars.h"
+#include "adsb_crc.h"
+#include "adsb_frame.h"
 
 /*==============================================
 FUNCTION: bin2int
@@ -153,28 +155,6 @@ void bin2hex(char *msgbin, char *msghex){
 	msghex[tamhex] = '\0';
 }
 
-/*==============================================
-FUNCTION: getDownlinkFormat
-INPUT: a char vector
-OUTPUT: it returns an integer
-DESCRIPTION: this function receives a vector of
-chars containing hexadecimal digits and calculates
-the downlinkFormat of the message represented by
-the sequence.
-================================================*/
-int getDownlinkFormat(char *msgi){
-	char msg_hex[3], msgbin[9], msgbin_aux[6];
-	msg_hex[0] = msgi[0];
-	msg_hex[1] = msgi[1];
-	msg_hex[2] = '\0';
-
-	hex2bin(msg_hex,msgbin);
-	strncpy(msgbin_aux,msgbin,5);
-	msgbin_aux[5] = '\0';
-
-	return bin2int(msgbin_aux);
-}
-
 /*==============================================
 FUNCTION: getFrame
 INPUT: a char vectors
@@ -199,53 +179,6 @@ void getFrame(char *msg){
 	}
 }
 
-/*==============================================
-FUNCTION: getICAO
-INPUT: two char vectors
-OUTPUT: a char vector, passed by reference
-DESCRIPTION: this function receives the 28 bytes
-of ADS-B data and returns the ICAO of the aircraft
-that sent that data.
-================================================*/
-void getICAO(char *msgi, char *msgf){
-	strncpy(msgf,&msgi[2],6);
-	msgf[6]='\0';
-}
-
-/*==============================================
-FUNCTION: getData
-INPUT: two char vectors
-OUTPUT: a char vector, passed by reference
-DESCRIPTION: this function receives the 28 bytes
-of ADS-B data and returns the 56 bits (or 14 bytes)
-of information, which can contain, for example, the
-velocity, latitude, etc. of the aircraft that sent
-the data.
-================================================*/
-void getData(char *msgi, char *msgf){
-	strncpy(msgf,&msgi[8],14);
-	msgf[14]='\0';
-}
-
-/*==============================================
-FUNCTION: getTypecode
-INPUT: a char vector
-OUTPUT: a integer
-DESCRIPTION: this function receives the 28 bytes
-(or 112 bits) of ADS-B data and returns its type-
-code, which indicates the kind of information
-the data contains. 
-================================================*/
-int getTypecode(char *msgi){
-	char msgbin[113];
-
-	hex2bin(msgi, msgbin);
-	strncpy(msgbin,&msgbin[32],5);
-	msgbin[5]='\0';
-
-	return bin2int(msgbin);
-}
-
 /*==============================================
 FUNCTION: getMOD
 INPUT: two float arguments
@@ -281,53 +214,23 @@ INPUT: a char vector and a pointer to an integer
 OUTPUT: an integer
 DESCRIPTION: this function receives an adsb message
 and returns if the received message is correct or
-not, applying CRC (Cyclic Redundancy Check). If this
-functions returns 0, the message has parity erros.
-Otherwise, the function returns 1.
+not, applying CRC (Cyclic Redundancy Check). The hex
+digits are packed into bytes and checked by
+CRC_syndrome(). If this functions returns 0, the
+message has parity erros. Otherwise, the function
+returns 1.
 ================================================*/
 int CRC_verifyMsg(char *msg, int *syndrome){
+	adsbFrame frame;
+	int len_msg = FRAME_fromHex(msg, &frame);
 
-	char GENERATOR[] = "1111111111111010000001001";
-
-	char msgbin[strlen(msg)*4+1];
-	char *remainder = NULL;
-	int pos_msg=0, pos_gen=0, len_msg = 0;
-	
-	hex2bin(msg,msgbin);
-	len_msg = strlen(msgbin);
-
-	//We are only dealing with messages of length 112.
-	//So, messages shorter than this length are not verified.
-	if(len_msg < LEN_ES_MSG){
+	//Only whole 56-bit or 112-bit messages can be verified.
+	if(len_msg == 0){
 		return 0;
 	}
+	*syndrome = (int)CRC_syndrome(frame.msg, len_msg);
 
-	//It performs the arithmetic division in module 2 (Check)
-	unsigned int len_gen = strlen(GENERATOR);
-	for(pos_msg = 0; pos_msg < len_msg-24; pos_msg++){	
-		if(msgbin[pos_msg] == '1'){
-			for(pos_gen = 0; pos_gen < len_gen; pos_gen++){
-				if((msgbin[pos_msg+pos_gen]-48) ^ (GENERATOR[pos_gen]-48)){
-					msgbin[pos_msg+pos_gen]='1';
-				}else{
-					msgbin[pos_msg+pos_gen]='0';
-				}
-			}
-		}
-	}	
-
-	printf("%s\n",msgbin);
-	*syndrome = bin2int(msgbin);
-
-	//If the remainder of the division is zero, the message is correct and we return 1.
-	//Otherwise, we return 0.
-	for(pos_msg = 0; pos_msg < len_msg; pos_msg++){
-		if(msgbin[pos_msg] == '1'){
-			return 0;
-		}
-	}
-
-	return 1;
+	return *syndrome == 0;
 }
 
 /*==============================================
@@ -336,25 +239,24 @@ INPUT: a char vector and a pointer to an integer
 OUTPUT: an integer
 DESCRIPTION: this function receives an adsb message
 and a syndrome and makes a one single bit CRC correction
-in the bit that generates that syndrome. If this
-functions returns 1, the message was succesfully
-corrected. Otherwise, the function returns 0.
+in the bit that generates that syndrome, found in the
+syndrome table of CRC_fixFrame(). If this functions
+returns 1, the message was succesfully corrected (and
+the syndrome is set to 0). Otherwise, the function
+returns 0.
 ================================================*/
 int CRC_correctMsg(char *msghex, int *syndrome){
-	char msgbin[4*strlen(msghex) + 1];
-	int i = 0;
-
-	hex2bin(msghex, msgbin);
-	for(i = 0; i < crcTableSize; i++){
-		if(crcSyndromeTable[i] == *syndrome){
-			msgbin[crcTableSize - i - 1] ^= 1;
-			bin2hex(msgbin, msghex);
+	adsbFrame frame;
+	int len_msg = FRAME_fromHex(msghex, &frame);
 
-			return CRC_verifyMsg(msghex, syndrome);
-		}
+	if((len_msg == 0) || (CRC_fixFrame(frame.msg, len_msg, (uint32_t)*syndrome, 1) != 1)){
+		return 0;
 	}
 
-	return 0;
+	FRAME_toHex(&frame, len_msg, msghex);
+	*syndrome = 0;
+
+	return 1;
 }
 
 /*==============================================
@@ -371,10 +273,7 @@ one single bit error.
 ================================================*/
 int CRC_tryMsg(char *msg, int *syndrome){
 	if(!CRC_verifyMsg(msg, syndrome)){
-		printf("CRC detected an error!\n");
-
 		if(CRC_correctMsg(msg, syndrome)){
-			printf("Message successfully corrected!\n");
 			return 1;
 		}
 
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <rtl-sdr.h>
+#include "adsb_capture.h"
+#include "adsb_createLog.h"
+
+/*==================================
+The ring is written only by the librtlsdr
+callback (producer) and read only by the
+processing loop (consumer). A slot is
+copied outside the lock, since the consumer
+can't see it before 'count' is incremented,
+and the producer never waits: if there is
+no free slot the buffer is dropped.
+===================================*/
+static struct{
+	rtlsdr_dev_t *dev;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t filled;
+
+	uint8_t **slots;
+	int *lengths;
+	int buf_num;
+	int buf_len;
+	int head;		//next slot to be written by the producer
+	int tail;		//next slot to be read by the consumer
+	int count;		//filled slots
+
+	volatile int running;
+	captureStats stats;
+}capture;
+
+static void *CAPTURE_thread(void *arg);
+static void CAPTURE_callback(unsigned char *buf, uint32_t len, void *ctx);
+static void CAPTURE_freeRing(void);
+
+/*==============================================
+FUNCTION: CAPTURE_start
+INPUT: the RTL-SDR device, the number and the
+length of the buffers
+OUTPUT: CAPTURE_OK or CAPTURE_ERROR
+DESCRIPTION: this function allocates a ring of
+buf_num buffers of buf_len bytes and starts the
+thread that runs rtlsdr_read_async(), using the
+same buf_num/buf_len for the USB transfers. The
+length must be a multiple of 512 bytes.
+================================================*/
+int CAPTURE_start(rtlsdr_dev_t *dev, int buf_num, int buf_len){
+	int i = 0;
+
+	if((dev == NULL) || (buf_num < 2) || (buf_len <= 0) || (buf_len % 512 != 0)){
+		fprintf(stderr, "Invalid capture configuration (buf_num=%d, buf_len=%d)\n", buf_num, buf_len);
+		return CAPTURE_ERROR;
+	}
+
+	memset(&capture, 0, sizeof(capture));
+	capture.dev = dev;
+	capture.buf_num = buf_num;
+	capture.buf_len = buf_len;
+
+	capture.slots = (uint8_t**)calloc(buf_num, sizeof(uint8_t*));
+	capture.lengths = (int*)calloc(buf_num, sizeof(int));
+	if(!capture.slots || !capture.lengths){
+		CAPTURE_freeRing();
+		LOG_add("CAPTURE_start", "capture ring couldn't be allocated");
+		return CAPTURE_ERROR;
+	}
+	for(i = 0; i < buf_num; i++){
+		capture.slots[i] = (uint8_t*)malloc(buf_len);
+		if(!capture.slots[i]){
+			CAPTURE_freeRing();
+			LOG_add("CAPTURE_start", "capture ring couldn't be allocated");
+			return CAPTURE_ERROR;
+		}
+	}
+
+	pthread_mutex_init(&capture.lock, NULL);
+	pthread_cond_init(&capture.filled, NULL);
+
+	capture.running = 1;
+	if(pthread_create(&capture.thread, NULL, CAPTURE_thread, NULL) != 0){
+		capture.running = 0;
+		pthread_cond_destroy(&capture.filled);
+		pthread_mutex_destroy(&capture.lock);
+		CAPTURE_freeRing();
+		LOG_add("CAPTURE_start", "capture thread couldn't be created");
+		return CAPTURE_ERROR;
+	}
+
+	printf("Async capture started (%d buffers of %d bytes).\n", buf_num, buf_len);
+	return CAPTURE_OK;
+}
+
+/*==============================================
+FUNCTION: CAPTURE_thread
+INPUT: unused
+OUTPUT: NULL
+DESCRIPTION: body of the capture thread. It blocks
+inside rtlsdr_read_async() until the transfers are
+cancelled or the device fails, and then wakes up the
+consumer so it can notice the end of the stream.
+================================================*/
+static void *CAPTURE_thread(void *arg){
+	(void)arg;
+
+	int r = rtlsdr_read_async(capture.dev, CAPTURE_callback, NULL, capture.buf_num, capture.buf_len);
+	if(r < 0){
+		fprintf(stderr, "rtlsdr_read_async failed (r=%d)\n", r);
+		LOG_add("CAPTURE_thread", "rtlsdr_read_async failed");
+	}
+
+	pthread_mutex_lock(&capture.lock);
+	capture.running = 0;
+	pthread_cond_broadcast(&capture.filled);
+	pthread_mutex_unlock(&capture.lock);
+
+	return NULL;
+}
+
+/*==============================================
+FUNCTION: CAPTURE_callback
+INPUT: the USB buffer, its length and a context
+OUTPUT: void
+DESCRIPTION: called by librtlsdr for each filled
+transfer. It copies the buffer into the next free
+slot of the ring or, if the ring is full, counts it
+as dropped. It never waits for the consumer, so the
+dongle is never stalled.
+================================================*/
+static void CAPTURE_callback(unsigned char *buf, uint32_t len, void *ctx){
+	(void)ctx;
+	int slot = 0, full = 0;
+
+	if((buf == NULL) || (len == 0)){
+		return;
+	}
+	if(len > (uint32_t)capture.buf_len){
+		len = capture.buf_len;
+	}
+
+	pthread_mutex_lock(&capture.lock);
+	capture.stats.received++;
+	full = (capture.count == capture.buf_num);
+	if(full){
+		capture.stats.dropped++;
+	}
+	slot = capture.head;
+	pthread_mutex_unlock(&capture.lock);
+
+	if(full){
+		return;
+	}
+
+	memcpy(capture.slots[slot], buf, len);
+	capture.lengths[slot] = len;
+
+	pthread_mutex_lock(&capture.lock);
+	capture.head = (capture.head + 1) % capture.buf_num;
+	capture.count++;
+	if((unsigned long)capture.count > capture.stats.maxUsed){
+		capture.stats.maxUsed = capture.count;
+	}
+	pthread_cond_signal(&capture.filled);
+	pthread_mutex_unlock(&capture.lock);
+}
+
+/*==============================================
+FUNCTION: CAPTURE_acquire
+INPUT: a pointer to an integer and a timeout
+OUTPUT: a pointer to the oldest filled buffer or NULL
+DESCRIPTION: waits up to timeout_ms for a filled
+buffer and returns it, saving its length in 'length'.
+The buffer belongs to the caller until
+CAPTURE_release() is called. Returns NULL on timeout
+or when the capture is no longer running.
+================================================*/
+uint8_t* CAPTURE_acquire(int *length, int timeout_ms){
+	struct timespec deadline;
+	uint8_t *buffer = NULL;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+	if(deadline.tv_nsec >= 1000000000L){
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&capture.lock);
+	while((capture.count == 0) && capture.running){
+		if(pthread_cond_timedwait(&capture.filled, &capture.lock, &deadline) == ETIMEDOUT){
+			break;
+		}
+	}
+	if(capture.count > 0){
+		buffer = capture.slots[capture.tail];
+		*length = capture.lengths[capture.tail];
+	}else{
+		*length = 0;
+	}
+	pthread_mutex_unlock(&capture.lock);
+
+	return buffer;
+}
+
+/*==============================================
+FUNCTION: CAPTURE_release
+INPUT: void
+OUTPUT: void
+DESCRIPTION: gives back to the producer the buffer
+returned by the last CAPTURE_acquire().
+================================================*/
+void CAPTURE_release(void){
+	pthread_mutex_lock(&capture.lock);
+	if(capture.count > 0){
+		capture.tail = (capture.tail + 1) % capture.buf_num;
+		capture.count--;
+	}
+	pthread_mutex_unlock(&capture.lock);
+}
+
+/*==============================================
+FUNCTION: CAPTURE_isRunning
+INPUT: void
+OUTPUT: 1 if the capture thread is running, 0 otherwise
+DESCRIPTION: buffers already in the ring can still be
+acquired after the capture has stopped.
+================================================*/
+int CAPTURE_isRunning(void){
+	return capture.running;
+}
+
+/*==============================================
+FUNCTION: CAPTURE_stop
+INPUT: void
+OUTPUT: void
+DESCRIPTION: cancels the async transfers, waits for
+the capture thread and frees the ring.
+================================================*/
+void CAPTURE_stop(void){
+	if(capture.slots == NULL){
+		return;
+	}
+
+	rtlsdr_cancel_async(capture.dev);
+	pthread_join(capture.thread, NULL);
+
+	pthread_cond_destroy(&capture.filled);
+	pthread_mutex_destroy(&capture.lock);
+	CAPTURE_freeRing();
+
+	printf("Async capture stopped: %lu buffers received, %lu dropped, max ring use %lu/%d.\n",
+	       capture.stats.received, capture.stats.dropped, capture.stats.maxUsed, capture.buf_num);
+}
+
+/*==============================================
+FUNCTION: CAPTURE_getStats
+INPUT: a pointer to captureStats
+OUTPUT: the counters, passed by reference
+DESCRIPTION: returns a snapshot of the capture
+counters.
+================================================*/
+void CAPTURE_getStats(captureStats *stats){
+	pthread_mutex_lock(&capture.lock);
+	*stats = capture.stats;
+	pthread_mutex_unlock(&capture.lock);
+}
+
+/*==============================================
+FUNCTION: CAPTURE_freeRing
+INPUT: void
+OUTPUT: void
+DESCRIPTION: frees the buffers of the ring.
+================================================*/
+static void CAPTURE_freeRing(void){
+	int i = 0;
+
+	if(capture.slots){
+		for(i = 0; i < capture.buf_num; i++){
+			free(capture.slots[i]);
+		}
+		free(capture.slots);
+	}
+	free(capture.lengths);
+	capture.slots = NULL;
+	capture.lengths = NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef ADSB_CAPTURE_H
+#define ADSB_CAPTURE_H
+
+#include <stdint.h>
+
+/*===============================
+These functions are responsible
+for the asynchronous capture of
+samples from the RTL-SDR device.
+A dedicated thread runs the
+librtlsdr async loop and hands the
+USB buffers to the processing side
+through a bounded ring of
+preallocated buffers.
+=================================*/
+
+//Default values for the librtlsdr async transfers
+#define CAPTURE_DEFAULT_BUF_NUM  16
+#define CAPTURE_DEFAULT_BUF_LEN  (16 * 16384)
+
+//Status Macros
+#define CAPTURE_ERROR -1
+#define CAPTURE_OK     0
+
+typedef struct rtlsdr_dev rtlsdr_dev_t;
+
+/*==================================
+STRUCT: captureStats
+DESCRIPTION:
+	unsigned long received: buffers delivered by the device.
+	unsigned long dropped: buffers discarded because the ring was full.
+	unsigned long maxUsed: high-water mark of filled ring slots.
+===================================*/
+typedef struct{
+	unsigned long received;
+	unsigned long dropped;
+	unsigned long maxUsed;
+}captureStats;
+
+int      CAPTURE_start(rtlsdr_dev_t *dev, int buf_num, int buf_len);
+uint8_t* CAPTURE_acquire(int *length, int timeout_ms);
+void     CAPTURE_release(void);
+int      CAPTURE_isRunning(void);
+void     CAPTURE_stop(void);
+void     CAPTURE_getStats(captureStats *stats);
+
+#endif
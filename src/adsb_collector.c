@@ -4,8 +4,9 @@
 #include <string.h>
 #include <math.h>
 #include <signal.h>
+#include <time.h>
 #include <unistd.h>
-#include <rtl-sdr.h>
+#include <getopt.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 
@@ -17,20 +18,24 @@
 #include "adsb_createLog.h"
 #include "adsb_db.h"         // DB_saveData(...)
 #include "board_monitor.h"   // board_monitor_init(...)
+#include "adsb_capture.h"    // CAPTURE_DEFAULT_BUF_NUM, CAPTURE_DEFAULT_BUF_LEN
+#include "adsb_source.h"     // SOURCE_open(...), SOURCE_acquire(...)
+#include "adsb_demod.h"      // DEMOD_process(...), DEMOD_setSNR(...)
+#include "adsb_crc.h"        // CRC_syndrome(...)
+#include "adsb_icao.h"       // ICAO_add(...), ICAO_isRecent(...)
+#include "adsb_commb.h"      // COMMB_getStats(...)
+#include "adsb_aircraft.h"   // AIRCRAFT_getStats(...)
 
 // Configuration defines
 #define DEFAULT_FREQUENCY      1090000000 // 1090 MHz
-#define DEFAULT_SAMPLE_RATE    2000000    // 2 MS/s
-#define BUFFER_LENGTH          (16 * 16384) 
+#define BUFFER_LENGTH          CAPTURE_DEFAULT_BUF_LEN
+#define ACQUIRE_TIMEOUT_MS     100
 
-#define DATA_LEN               112  // 112 bits for Mode-S frames
-#define SAMPLES_PER_MICROSEC   (DEFAULT_SAMPLE_RATE / 1000000)
-#define PREAMBLE_LEN           (8 * SAMPLES_PER_MICROSEC)    // 8 µs
-#define MESSAGE_LEN            (DATA_LEN * SAMPLES_PER_MICROSEC)
-#define THRESHOLD_LEVEL        30  // Adjust as needed
-
-// Global pointer to RTL-SDR device
-static rtlsdr_dev_t *dev = NULL;
+// Error correction policies of the extended squitters (-x/--fix)
+#define FIX_NONE               0    // only frames with a correct parity
+#define FIX_SINGLE             1    // 1-bit errors
+#define FIX_DOUBLE_KNOWN       2    // and 2-bit errors of aircraft seen recently
+#define FIX_DOUBLE             3    // 1-bit and 2-bit errors
 
 // ADS-B messages list
 adsbMsg *messagesList = NULL;
@@ -38,49 +43,249 @@ adsbMsg *messagesList = NULL;
 // Flag for Ctrl+C
 static volatile int do_exit = 0;
 
+// Streaming demodulator (carries the tail of each block to the next one)
+static demodState demod;
+
+// Where the samples come from: the first RTL-SDR device by default
+static sourceConfig source = {
+    SOURCE_RTLSDR, NULL, 0, DEFAULT_FREQUENCY, DEFAULT_SAMPLE_RATE,
+    CAPTURE_DEFAULT_BUF_NUM, BUFFER_LENGTH, 0
+};
+
+// Required preamble pulse level above the noise floor, in dB
+static double snr_db = DEFAULT_SNR_DB;
+
+// Pragmas of the database connection
+static dbConfig database = {
+    DB_DEFAULT_SYNCHRONOUS, DB_DEFAULT_CACHE_KB, DB_DEFAULT_MMAP_MB,
+    DB_DEFAULT_BUSY_MS, DB_DEFAULT_CHECKPOINT_MS
+};
+
+// Aircraft not updated for longer are dropped from the table, in s
+static double aircraft_idle = AIRCRAFT_DEFAULT_IDLE;
+
+// Error correction policy
+static int fix_policy = FIX_SINGLE;
+static const char *const fix_names[] = {"none", "1", "2-known", "2"};
+
+// Parity check counters: frames passed/failed, formats not decoded skipped
+static unsigned long crc_ok = 0, crc_failed = 0, crc_skipped = 0;
+// Address/parity replies whose address wasn't seen recently
+static unsigned long ap_unknown = 0;
+// Frames recovered by the correction, and 2-bit fixes refused for unknown aircraft
+static unsigned long crc_fixed[CRC_MAX_ERRORS + 1] = {0}, crc_unknown = 0;
+
 // Forward declarations
 static void sigintHandler(int signo);
+static void usage(const char *prog);
 static void main_loop();
-static void process_samples(uint8_t *buffer, int length);
-static void detect_adsb(uint8_t *samples, int length);
-static int  is_preamble(uint8_t *samples, int index);
-static void extract_bits(uint8_t *samples, int index, uint8_t *bits);
-static void decode_and_save_adsb(uint8_t *bits);
+static void process_samples(const uint8_t *buffer, int length);
+static void decode_and_save_adsb(adsbFrame *frame);
+static int check_parity(adsbFrame *frame);
+static int check_address(const adsbFrame *frame);
 
 /*!
  * \brief Main entry point.
  */
 int main(int argc, char **argv)
 {
-    signal(SIGINT, sigintHandler);
-
-    // Open the first RTL-SDR device (index=0)
-    int device_index = 0;
-    int r = rtlsdr_open(&dev, device_index);
-    if (r < 0) {
-        fprintf(stderr, "Failed to open RTL-SDR device index %d.\n", device_index);
+    static const struct option long_options[] = {
+        {"buf-num", required_argument, NULL, 'b'},
+        {"buf-len", required_argument, NULL, 'l'},
+        {"snr",     required_argument, NULL, 's'},
+        {"file",    required_argument, NULL, 'f'},
+        {"realtime", no_argument,      NULL, 'R'},
+        {"fix",     required_argument, NULL, 'x'},
+        {"position", required_argument, NULL, 'p'},
+        {"aircraft", required_argument, NULL, 'a'},
+        {"expire",  required_argument, NULL, 'e'},
+        {"batch",   required_argument, NULL, 'B'},
+        {"batch-ms", required_argument, NULL, 'W'},
+        {"queue",   required_argument, NULL, 'Q'},
+        {"synchronous", required_argument, NULL, 'S'},
+        {"cache",   required_argument, NULL, 'C'},
+        {"mmap",    required_argument, NULL, 'M'},
+        {"busy",    required_argument, NULL, 'T'},
+        {"checkpoint", required_argument, NULL, 'K'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    positionStats positions;
+    decodeStats decoded;
+    commbStats commb;
+    aircraftStats aircraft;
+    dbStats db;
+    int capacity = AIRCRAFT_DEFAULT_CAPACITY;
+    int batch_rows = DB_DEFAULT_BATCH_ROWS;
+    int batch_ms = DB_DEFAULT_BATCH_MS;
+    int queue_rows = DB_DEFAULT_QUEUE;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "b:l:s:f:Rx:p:a:e:B:W:Q:S:C:M:T:K:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'b':
+                source.buf_num = atoi(optarg);
+                break;
+            case 'l':
+                source.buf_len = atoi(optarg);
+                break;
+            case 's':
+                snr_db = atof(optarg);
+                break;
+            case 'f':
+                source.type = (strcmp(optarg, "-") == 0) ? SOURCE_STDIN : SOURCE_FILE;
+                source.path = optarg;
+                break;
+            case 'R':
+                source.realtime = 1;
+                break;
+            case 'x':
+                for (fix_policy = FIX_DOUBLE; fix_policy >= FIX_NONE; fix_policy--) {
+                    if (strcmp(optarg, fix_names[fix_policy]) == 0) {
+                        break;
+                    }
+                }
+                if (fix_policy < FIX_NONE) {
+                    fprintf(stderr, "Unknown correction policy: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'p': {
+                double lat = 0, lon = 0;
+                if (sscanf(optarg, "%lf,%lf", &lat, &lon) != 2 ||
+                    lat < -90 || lat > 90 || lon < -180 || lon > 180) {
+                    fprintf(stderr, "Invalid receiver position: %s\n", optarg);
+                    return 1;
+                }
+                setReceiverPosition(lat, lon);
+                break;
+            }
+            case 'a':
+                capacity = atoi(optarg);
+                break;
+            case 'e':
+                aircraft_idle = atof(optarg);
+                if (aircraft_idle <= 0) {
+                    fprintf(stderr, "Invalid expiry time: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'B':
+                batch_rows = atoi(optarg);
+                break;
+            case 'W':
+                batch_ms = atoi(optarg);
+                break;
+            case 'Q':
+                queue_rows = atoi(optarg);
+                break;
+            case 'S':
+                database.synchronous = optarg;
+                break;
+            case 'C':
+                database.cacheKb = atoi(optarg);
+                break;
+            case 'M':
+                database.mmapMb = atoi(optarg);
+                break;
+            case 'T':
+                database.busyMs = atoi(optarg);
+                break;
+            case 'K':
+                database.checkpointMs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (source.buf_num < 2 || source.buf_len < 512 || source.buf_len % 512 != 0) {
+        fprintf(stderr, "Invalid buffers: need buf-num >= 2 and buf-len a multiple of 512.\n");
         return 1;
     }
 
-    // Configure frequency, sample rate, etc.
-    rtlsdr_set_center_freq(dev, DEFAULT_FREQUENCY);
-    printf("Tuned to %u Hz.\n", DEFAULT_FREQUENCY);
-
-    rtlsdr_set_sample_rate(dev, DEFAULT_SAMPLE_RATE);
-    printf("Sample rate set to %u Hz.\n", DEFAULT_SAMPLE_RATE);
+    signal(SIGINT, sigintHandler);
 
-    // Enable auto-gain
-    rtlsdr_set_tuner_gain_mode(dev, 0);
+    // Build the IQ -> magnitude table and pick the SIMD kernels for this CPU
+    DEMOD_init();
+    DEMOD_initState(&demod);
+    DEMOD_setSNR(&demod, snr_db);
+    CRC_init();
+    DECODING_init();
+    if (AIRCRAFT_init(capacity) != AIRCRAFT_OK) {
+        fprintf(stderr, "Invalid aircraft capacity: %d\n", capacity);
+        return 1;
+    }
+    // One connection for the whole run; the saves retry it if it fails here
+    if (DB_configure(&database) != DATABASE_OK) {
+        fprintf(stderr, "Invalid database settings: synchronous %s, cache %d KiB, mmap %d MiB, "
+                "busy %d ms, checkpoint %d ms\n", database.synchronous, database.cacheKb,
+                database.mmapMb, database.busyMs, database.checkpointMs);
+        return 1;
+    }
+    if (DB_init(DATABASE) != DATABASE_OK) {
+        fprintf(stderr, "Failed to open the database %s.\n", DATABASE);
+    }
+    // The inserts are made by the writer thread, in batches, off the sample path
+    if (DB_startWriter(queue_rows, batch_rows, batch_ms) != DATABASE_OK) {
+        fprintf(stderr, "Invalid database queue: %d rows, batches of %d rows or %d ms\n",
+                queue_rows, batch_rows, batch_ms);
+        return 1;
+    }
 
-    // Reset buffer
-    rtlsdr_reset_buffer(dev);
+    // Open the device (tuned, auto-gain) or the recorded samples
+    if (SOURCE_open(&source) != SOURCE_OK) {
+        fprintf(stderr, "Failed to open the sample source.\n");
+        return 1;
+    }
 
     // Main loop reading data
     main_loop();
-
-    // Cleanup
-    rtlsdr_close(dev);
-    dev = NULL;
+    SOURCE_close();
+    DB_stopWriter();
+    DB_shutdown();
+
+    printf("Frames detected: %lu, %lu of 56 bits (%lu recovered across buffer boundaries).\n",
+           demod.frames, demod.shortFrames, demod.recovered);
+    printf("Parity check: %lu frames passed, %lu failed (%lu with an unknown address), %lu of other formats.\n",
+           crc_ok, crc_failed, ap_unknown, crc_skipped);
+    printf("Error correction (%s): %lu 1-bit and %lu 2-bit fixes, %lu 2-bit fixes refused for unknown aircraft.\n",
+           fix_names[fix_policy], crc_fixed[1], crc_fixed[2], crc_unknown);
+    printf("Aircraft addresses seen in the last %d s: %d.\n", ICAO_RECENT_TIME, ICAO_count());
+    AIRCRAFT_getStats(&aircraft);
+    printf("Aircraft table: %d tracked, high-water mark %d of %d records (%lu expired, %lu recycled), %.2f probes per lookup.\n",
+           aircraft.count, aircraft.highWater, aircraft.capacity, aircraft.expired, aircraft.recycled,
+           aircraft.lookups ? (double)aircraft.probes / aircraft.lookups : 0.0);
+    DB_getStats(&db);
+    printf("Database: %lu rows written in %lu commits (%.1f ms average, %.1f ms max), %lu failed, %lu dropped with the queue full (max use %lu/%d).\n",
+           db.written, db.commits, db.commits ? db.commitMs / db.commits : 0.0, db.maxCommitMs,
+           db.failed, db.dropped, db.maxUsed, queue_rows);
+    printf("WAL checkpoints: %lu, last one at %lu pages (%lu held by readers), largest %lu pages.\n",
+           db.checkpoints, db.walFrames, db.walPending, db.maxWalFrames);
+    printf("Airline pairs already saved, not written again: %lu.\n", db.airlineSkipped);
+    getDecodeStats(&decoded);
+    printf("Decoded per format:");
+    for (int i = 0; i < 32; i++) {
+        if (decoded.dfDecoded[i] || decoded.dfFailed[i]) {
+            printf(" DF%d %lu/%lu", i, decoded.dfDecoded[i], decoded.dfDecoded[i] + decoded.dfFailed[i]);
+        }
+    }
+    printf("\nDecoded per type code:");
+    for (int i = 0; i < 32; i++) {
+        if (decoded.tcDecoded[i] || decoded.tcFailed[i]) {
+            printf(" TC%d %lu/%lu", i, decoded.tcDecoded[i], decoded.tcDecoded[i] + decoded.tcFailed[i]);
+        }
+    }
+    printf("\n");
+    COMMB_getStats(&commb);
+    printf("Comm-B registers: %lu BDS 4,0, %lu BDS 5,0, %lu BDS 6,0, %lu ambiguous, %lu unknown.\n",
+           commb.bds40, commb.bds50, commb.bds60, commb.ambiguous, commb.unknown);
+    getPositionStats(&positions);
+    printf("Positions: %lu global, %lu local from the last fix, %lu local from the receiver, %lu surface, %lu not decoded.\n",
+           positions.global, positions.local_fix, positions.local_receiver, positions.surface, positions.undecoded);
+    printf("Noise floor: %.2f (pulse level %.2f at %.1f dB).\n",
+           (double)demod.noise / MAG_SCALE, (double)DEMOD_pulseLevel(&demod) / MAG_SCALE, snr_db);
+    DEMOD_freeState(&demod);
 
     // Free ADS-B message list
     LIST_removeAll(&messagesList);
@@ -90,171 +295,209 @@ int main(int argc, char **argv)
 }
 
 /*!
- * \brief Called in main() to continuously read samples in a blocking loop
- *        and process them until do_exit is set (Ctrl+C).
+ * \brief Prints the command line options.
+ */
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  -b, --buf-num N   number of async USB buffers (default %d)\n"
+           "  -l, --buf-len N   length of each buffer in bytes, multiple of 512 (default %d)\n"
+           "  -f, --file PATH   read cu8 IQ samples from PATH (\"-\" for stdin) instead of the device\n"
+           "  -R, --realtime    replay the file at the sample rate instead of as fast as possible\n"
+           "  -x, --fix POLICY  bit error correction: none, 1, 2-known (2-bit only for aircraft\n"
+           "                    seen recently) or 2 (default 1)\n"
+           "  -s, --snr DB      preamble pulses must exceed the noise floor by DB (default %.1f)\n"
+           "  -p, --position LAT,LON  receiver position, to decode the first positions of an\n"
+           "                    aircraft without waiting for an even/odd pair\n"
+           "  -a, --aircraft N  aircraft records allocated at startup; when they are all in use\n"
+           "                    the least recently updated aircraft is dropped (default %d)\n"
+           "  -e, --expire S    drop the aircraft not updated for S seconds (default %d)\n"
+           "  -B, --batch N     rows inserted in one database transaction, at most (default %d)\n"
+           "  -W, --batch-ms MS commit the rows queued for MS ms, at most (default %d)\n"
+           "  -Q, --queue N     rows waiting for the database writer; when it is full the rows\n"
+           "                    are dropped (default %d)\n"
+           "  -S, --synchronous MODE  database sync: OFF, NORMAL, FULL or EXTRA (default %s)\n"
+           "  -C, --cache KB    database page cache in KiB (default %d)\n"
+           "  -M, --mmap MB     database memory map in MiB, 0 to disable (default %d)\n"
+           "  -T, --busy MS     wait up to MS ms for a database lock (default %d)\n"
+           "  -K, --checkpoint MS  copy the WAL into the database every MS ms, 0 to leave it\n"
+           "                    to SQLite (default %d)\n"
+           "  -h, --help        show this help\n",
+           prog, CAPTURE_DEFAULT_BUF_NUM, BUFFER_LENGTH, DEFAULT_SNR_DB, AIRCRAFT_DEFAULT_CAPACITY,
+           AIRCRAFT_DEFAULT_IDLE, DB_DEFAULT_BATCH_ROWS, DB_DEFAULT_BATCH_MS, DB_DEFAULT_QUEUE,
+           DB_DEFAULT_SYNCHRONOUS, DB_DEFAULT_CACHE_KB, DB_DEFAULT_MMAP_MB, DB_DEFAULT_BUSY_MS,
+           DB_DEFAULT_CHECKPOINT_MS);
+}
+
+/*!
+ * \brief Called in main() to process the blocks delivered by the sample
+ *        source until do_exit is set (Ctrl+C) or the source ends.
+ *        The dongle is drained by the capture thread, so slow decoding
+ *        or database work only costs dropped buffers, which are counted.
+ *        After each block the aircraft not updated for aircraft_idle
+ *        seconds are expired, which costs nothing when there are none.
+ *        At the end, the throughput of the whole pipeline is printed,
+ *        which benchmarks it when replaying a recorded file.
  */
 static void main_loop()
 {
-    printf("Starting to read samples...\n");
-    uint8_t buffer[BUFFER_LENGTH];
+    sourceStats stats;
+    struct timespec start, end;
+    unsigned long reported_drops = 0;
     int n_read = 0;
 
+    printf("Starting to read samples...\n");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     while (!do_exit) {
-        // Read a block of samples
-        int r = rtlsdr_read_sync(dev, buffer, BUFFER_LENGTH, &n_read);
-        if (r < 0) {
-            fprintf(stderr, "Failed to read samples (r=%d)\n", r);
-            break;
+        const uint8_t *buffer = SOURCE_acquire(&n_read, ACQUIRE_TIMEOUT_MS);
+        if (buffer == NULL) {
+            if (!SOURCE_isRunning()) {
+                fprintf(stderr, "Sample source ended, leaving main loop.\n");
+                break;
+            }
+            continue;
         }
-        if (n_read > 0) {
-            process_samples(buffer, n_read);
-        } else {
-            // Possibly a timeout or no data
-            usleep(1000);
+
+        process_samples(buffer, n_read);
+        SOURCE_release();
+
+        if (AIRCRAFT_expire(getCurrentTime(), aircraft_idle) > 0) {
+            messagesList = AIRCRAFT_oldest();
         }
-    }
-}
 
-/*!
- * \brief Convert IQ samples to magnitude, then detect potential ADS-B frames.
- */
-static void process_samples(uint8_t *buffer, int length)
-{
-    // Each sample is 2 bytes: I, Q
-    int mag_length = length / 2;
-    if (mag_length < PREAMBLE_LEN + MESSAGE_LEN) {
-        return;
+        SOURCE_getStats(&stats);
+        if (stats.dropped != reported_drops) {
+            printf("Warning: %lu sample buffers dropped so far.\n", stats.dropped);
+            reported_drops = stats.dropped;
+        }
     }
 
-    // Convert to magnitude (re-center around 0 by subtracting 127)
-    uint8_t magnitude[mag_length];
-    for (int i = 0; i < mag_length; i++) {
-        int8_t I = (int8_t)(buffer[2*i]   - 127);
-        int8_t Q = (int8_t)(buffer[2*i+1] - 127);
-        float amp = sqrtf((float)(I*I + Q*Q));
-        magnitude[i] = (uint8_t)amp;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    SOURCE_getStats(&stats);
 
-    // Now detect Mode-S preambles
-    detect_adsb(magnitude, mag_length);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double samples = stats.bytes / 2.0;
+    printf("Processed %.0f samples from %s in %.2f s (%.2f MS/s).\n",
+           samples, SOURCE_getName(), elapsed, (elapsed > 0) ? samples / elapsed / 1e6 : 0.0);
 }
 
 /*!
- * \brief Scans 'samples' for a valid Mode-S preamble, then extracts bits and decodes.
+ * \brief Convert IQ samples to magnitude, then detect potential ADS-B frames.
+ *        The demodulator keeps the end of each block, so frames crossing
+ *        a buffer boundary are detected with the next block.
  */
-static void detect_adsb(uint8_t *samples, int length)
+static void process_samples(const uint8_t *buffer, int length)
 {
-    for (int i = 0; i < length - (PREAMBLE_LEN + MESSAGE_LEN); i++) {
-        if (is_preamble(samples, i)) {
-            // Extract 112 bits
-            uint8_t bits[DATA_LEN];
-            extract_bits(samples, i + PREAMBLE_LEN, bits);
-
-            // Decode and attempt DB save
-            decode_and_save_adsb(bits);
-
-            // Skip ahead to avoid re-detecting the same frame
-            i += PREAMBLE_LEN + MESSAGE_LEN;
-        }
+    if (DEMOD_process(&demod, buffer, length, decode_and_save_adsb) != DEMOD_OK) {
+        fprintf(stderr, "Failed to demodulate a block of %d bytes.\n", length);
     }
 }
 
 /*!
- * \brief Check if we have a Mode-S preamble at 'index'.
- *        Very simplified approach: checks a few samples vs. THRESHOLD_LEVEL.
+ * \brief Checks the parity of an extended squitter and, if it is wrong,
+ *        tries to correct it according to the policy. A 2-bit fix has a
+ *        higher chance of producing a wrong frame, so with "2-known" it is
+ *        only accepted if the corrected address was seen recently.
+ * \return 1 if the frame (maybe corrected) is valid, 0 otherwise.
  */
-static int is_preamble(uint8_t *samples, int index)
+static int check_parity(adsbFrame *frame)
 {
-    // "Pulse" positions
-    static const int pulse_positions[]    = {0, 1, 3};
-    static const int no_pulse_positions[] = {2, 4, 5, 6, 7};
-
-    // Check pulses
-    for (int p = 0; p < (int)(sizeof(pulse_positions)/sizeof(int)); p++) {
-        int pos = index + pulse_positions[p]*SAMPLES_PER_MICROSEC;
-        int sum = 0;
-        for (int j = 0; j < SAMPLES_PER_MICROSEC; j++) {
-            sum += samples[pos + j];
-        }
-        int avg = sum / SAMPLES_PER_MICROSEC;
-        if (avg < THRESHOLD_LEVEL) {
-            return 0; 
-        }
+    static const int max_errors[] = {0, 1, 2, 2};
+    adsbFrame fixed = *frame;
+    uint32_t syndrome = CRC_syndrome(frame->msg, CRC_LONG_BITS);
+    int errors = 0;
+
+    if (syndrome == 0) {
+        return 1;
     }
 
-    // Check no-pulse
-    for (int p = 0; p < (int)(sizeof(no_pulse_positions)/sizeof(int)); p++) {
-        int pos = index + no_pulse_positions[p]*SAMPLES_PER_MICROSEC;
-        int sum = 0;
-        for (int j = 0; j < SAMPLES_PER_MICROSEC; j++) {
-            sum += samples[pos + j];
-        }
-        int avg = sum / SAMPLES_PER_MICROSEC;
-        if (avg > THRESHOLD_LEVEL) {
-            return 0; 
-        }
+    errors = CRC_fixFrame(fixed.msg, CRC_LONG_BITS, syndrome, max_errors[fix_policy]);
+    if (errors == CRC_UNFIXABLE) {
+        return 0;
+    }
+    if (errors == 2 && fix_policy == FIX_DOUBLE_KNOWN && !ICAO_isRecent(FRAME_icao(&fixed))) {
+        crc_unknown++;
+        return 0;
     }
 
-    return 1; // If we pass all checks, assume it's a preamble
+    *frame = fixed;
+    crc_fixed[errors]++;
+    return 1;
 }
 
 /*!
- * \brief Extracts 112 bits from the magnitude array, 2 samples per bit (1µs=2 samples).
+ * \brief Checks the parity of an all-call reply (DF11) or of a reply whose
+ *        parity is overlaid with the address (AP: DF4/5/20/21).
+ *        The DF11 parity is overlaid with the interrogator code, which
+ *        only takes the low 7 bits; a non-zero code is only accepted from
+ *        an aircraft seen recently. The syndrome of an AP reply is the
+ *        address itself, so it is only accepted if that address was seen
+ *        recently in a frame that announces it; otherwise a corrupted
+ *        reply can't be told from a new aircraft.
+ * \return 1 if the frame is valid, 0 otherwise.
  */
-static void extract_bits(uint8_t *samples, int index, uint8_t *bits)
+static int check_address(const adsbFrame *frame)
 {
-    for (int i = 0; i < DATA_LEN; i++) {
-        int bit_start = index + i*SAMPLES_PER_MICROSEC*2;
-        int sum_on = 0;
-        int sum_off=0;
-
-        // First half
-        for (int j = 0; j < SAMPLES_PER_MICROSEC; j++){
-            sum_on += samples[bit_start + j];
-        }
-        // Second half
-        for (int j = 0; j < SAMPLES_PER_MICROSEC; j++){
-            sum_off += samples[bit_start + SAMPLES_PER_MICROSEC + j];
-        }
+    uint32_t syndrome = CRC_syndrome(frame->msg, FRAME_bits(frame));
 
-        // Very naive: if first half is high, second half low => bit=1, else bit=0
-        if (sum_on > THRESHOLD_LEVEL*SAMPLES_PER_MICROSEC && 
-            sum_off< THRESHOLD_LEVEL*SAMPLES_PER_MICROSEC){
-            bits[i]=1;
-        } else if(sum_on< THRESHOLD_LEVEL*SAMPLES_PER_MICROSEC && 
-                  sum_off> THRESHOLD_LEVEL*SAMPLES_PER_MICROSEC){
-            bits[i]=0;
-        } else {
-            bits[i]=0;
-        }
+    if (FRAME_df(frame) == 11) {
+        // A bit error in the last 7 bits looks like an interrogator code
+        return (syndrome == 0) ||
+               ((syndrome & ~0x7Fu) == 0 && ICAO_isRecent(FRAME_icao(frame)));
     }
+    if (!ICAO_isRecent(syndrome)) {
+        ap_unknown++;
+        return 0;
+    }
+    return 1;
 }
 
 /*!
- * \brief Converts bits -> 28-hex string, calls decodeMessage, if complete => DB_saveData.
+ * \brief Checks the parity of the frame, calls decodeMessage, if complete => DB_saveData.
+ *        The extended squitters (DF17/DF18) carry a plain parity, which can be
+ *        corrected; DF11 and the surveillance replies (DF4/5/20/21) overlay
+ *        it with the interrogator or the aircraft address. The addresses of
+ *        the valid DF11/17/18 frames are kept to check the AP replies.
  */
-static void decode_and_save_adsb(uint8_t *bits)
+static void decode_and_save_adsb(adsbFrame *frame)
 {
-    // Convert 112 bits => 14 bytes => 28 hex
-    uint8_t bytes[14];
-    memset(bytes, 0, sizeof(bytes));
-    for (int i = 0; i < DATA_LEN; i++) {
-        bytes[i/8] <<= 1;
-        bytes[i/8] |= bits[i];
+    char hex_string[FRAME_HEX_LEN + 1];
+    int df = FRAME_df(frame);
+    int valid = 0;
+
+    switch (df) {
+        case 17:
+        case 18:
+            valid = check_parity(frame);
+            break;
+        case 11:
+        case 4:
+        case 5:
+        case 20:
+        case 21:
+            valid = check_address(frame);
+            break;
+        default:
+            crc_skipped++;
+            return;
     }
-
-    char hex_string[29];
-    for (int i = 0; i < 14; i++){
-        sprintf(hex_string + (2*i), "%02X", bytes[i]);
+    if (!valid) {
+        crc_failed++;
+        return;
+    }
+    crc_ok++;
+    if ((df == 11 || df == 17 || df == 18) && isIcaoAddress(frame)) {
+        ICAO_add(FRAME_icao(frame));
     }
-    hex_string[28] = '\0';
 
     // Debug print
+    FRAME_toHex(frame, FRAME_bits(frame), hex_string);
     printf("ADS-B Message: %s\n", hex_string);
 
     // Use decodeMessage(...) from adsb_decoding.c
     static adsbMsg *node = NULL;
-    messagesList = decodeMessage(hex_string, messagesList, &node);
+    messagesList = decodeMessage(frame, messagesList, &node);
 
     // If decode returned a node and it's "complete," we save to DB
     if (node) {
@@ -266,9 +509,9 @@ static void decode_and_save_adsb(uint8_t *bits)
             getCpuUsage(&user_cpu, &sys_cpu, &max_rss);
             DB_saveSystemMetrics(user_cpu, sys_cpu, max_rss);
             if (ret != 0) {
-                printf("Failed to save data for %s.\n", completeNode->ICAO);
+                printf("Failed to save data for %06X.\n", completeNode->address);
             } else {
-                printf("Aircraft %s saved successfully!\n", completeNode->ICAO);
+                printf("Aircraft %06X saved successfully!\n", completeNode->address);
                 // optional: clearMinimalInfo(completeNode);
             }
         }
@@ -0,0 +1,245 @@
+#include <string.h>
+#include "adsb_commb.h"
+
+static commbStats stats;
+
+/*==============================================
+FUNCTION: MB
+INPUT: a frame, the first bit of the field and
+its length
+OUTPUT: the field value
+DESCRIPTION: the bits of the MB field are numbered
+from 1, as in the register tables (ICAO Doc 9871),
+so MB bit 1 is the frame bit 32.
+================================================*/
+static inline int MB(const adsbFrame *frame, int first, int count){
+	return (int)FRAME_getBits(frame, 31 + first, count);
+}
+
+//Field with a sign bit in front of it (two's complement)
+static inline int signedMB(const adsbFrame *frame, int sign, int first, int count){
+	int value = MB(frame, first, count);
+	return MB(frame, sign, 1) ? value - (1 << count) : value;
+}
+
+//A field whose status bit is clear must be all zeros
+static inline int statusOk(const adsbFrame *frame, int status, int first, int count){
+	return MB(frame, status, 1) || (MB(frame, first, count) == 0);
+}
+
+static float toAngle360(float angle){
+	return (angle < 0) ? angle + 360 : angle;
+}
+
+/*==============================================
+FUNCTION: isBDS40
+INPUT: a frame
+OUTPUT: 1 if the MB field fits the register 4,0
+(selected vertical intention), 0 otherwise
+================================================*/
+static int isBDS40(const adsbFrame *frame){
+	if(MB(frame, 40, 8) || MB(frame, 52, 2)){
+		return 0;                                   // reserved bits
+	}
+	if(!statusOk(frame, 1, 2, 12) || !statusOk(frame, 14, 15, 12) || !statusOk(frame, 27, 28, 12) ||
+	   !statusOk(frame, 48, 49, 3) || !statusOk(frame, 54, 55, 2)){
+		return 0;
+	}
+	if(!MB(frame, 1, 1) && !MB(frame, 14, 1) && !MB(frame, 27, 1)){
+		return 0;
+	}
+	if((MB(frame, 1, 1) && (MB(frame, 2, 12) * 16 > 50000)) ||
+	   (MB(frame, 14, 1) && (MB(frame, 15, 12) * 16 > 50000))){
+		return 0;
+	}
+	if(MB(frame, 27, 1) && ((MB(frame, 28, 12) < 500) || (MB(frame, 28, 12) > 3000))){
+		return 0;                                   // outside 850..1100 mb
+	}
+	return 1;
+}
+
+/*==============================================
+FUNCTION: isBDS50
+INPUT: a frame
+OUTPUT: 1 if the MB field fits the register 5,0
+(track and turn report), 0 otherwise
+================================================*/
+static int isBDS50(const adsbFrame *frame){
+	int gs = MB(frame, 25, 10) * 2, tas = MB(frame, 47, 10) * 2;
+
+	if(!statusOk(frame, 1, 2, 10) || !statusOk(frame, 12, 13, 11) || !statusOk(frame, 24, 25, 10) ||
+	   !statusOk(frame, 35, 36, 10) || !statusOk(frame, 46, 47, 10)){
+		return 0;
+	}
+	if(!MB(frame, 1, 1) && !MB(frame, 12, 1) && !MB(frame, 24, 1) && !MB(frame, 35, 1) && !MB(frame, 46, 1)){
+		return 0;
+	}
+	// |roll| up to 50 degrees, that is 284 steps of 45/256
+	if(MB(frame, 1, 1) && ((signedMB(frame, 2, 3, 9) > 284) || (signedMB(frame, 2, 3, 9) < -284))){
+		return 0;
+	}
+	if((gs > 600) || (tas > 600)){
+		return 0;
+	}
+	if(MB(frame, 24, 1) && MB(frame, 46, 1) && ((gs - tas > 200) || (tas - gs > 200))){
+		return 0;
+	}
+	return 1;
+}
+
+/*==============================================
+FUNCTION: isBDS60
+INPUT: a frame
+OUTPUT: 1 if the MB field fits the register 6,0
+(heading and speed report), 0 otherwise
+================================================*/
+static int isBDS60(const adsbFrame *frame){
+	int ias = MB(frame, 14, 10);
+	int mach = MB(frame, 25, 10);       // steps of 0.004
+	int baro = signedMB(frame, 36, 37, 9), inertial = signedMB(frame, 47, 48, 9);
+
+	if(!statusOk(frame, 1, 2, 11) || !statusOk(frame, 13, 14, 10) || !statusOk(frame, 24, 25, 10) ||
+	   !statusOk(frame, 35, 36, 10) || !statusOk(frame, 46, 47, 10)){
+		return 0;
+	}
+	if(!MB(frame, 1, 1) && !MB(frame, 13, 1) && !MB(frame, 24, 1) && !MB(frame, 35, 1) && !MB(frame, 46, 1)){
+		return 0;
+	}
+	if((ias > 500) || (mach > 250)){
+		return 0;                           // 500 kt, Mach 1
+	}
+	// vertical rates up to 6000 ft/min, in steps of 32
+	if((baro > 187) || (baro < -187) || (inertial > 187) || (inertial < -187)){
+		return 0;
+	}
+	// IAS between 30% of the TAS at FL450 and the TAS at sea level
+	if(MB(frame, 13, 1) && MB(frame, 24, 1) &&
+	   ((ias * 1000 > mach * 2646 + 50000) || (ias * 1000 < mach * 688))){
+		return 0;
+	}
+	return 1;
+}
+
+/*==============================================
+FUNCTION: COMMB_inferBDS
+INPUT: a DF20/21 frame
+OUTPUT: COMMB_BDS40, COMMB_BDS50, COMMB_BDS60,
+COMMB_AMBIGUOUS or COMMB_UNKNOWN
+DESCRIPTION: tries the three registers on the MB
+field. Most replies are refused by the first
+status bit whose field isn't zero, so the test
+costs a few bit extractions.
+================================================*/
+int COMMB_inferBDS(const adsbFrame *frame){
+	int bds = COMMB_UNKNOWN, count = 0;
+
+	if(FRAME_bits(frame) != FRAME_LONG_BITS){
+		return COMMB_UNKNOWN;
+	}
+	if(isBDS40(frame)){
+		bds = COMMB_BDS40;
+		count++;
+	}
+	if(isBDS50(frame)){
+		bds = COMMB_BDS50;
+		count++;
+	}
+	if(isBDS60(frame)){
+		bds = COMMB_BDS60;
+		count++;
+	}
+	return (count > 1) ? COMMB_AMBIGUOUS : bds;
+}
+
+/*==============================================
+FUNCTION: COMMB_decode
+INPUT: a DF20/21 frame and a pointer to commbData
+OUTPUT: the register decoded (as COMMB_inferBDS)
+DESCRIPTION: infers the register and decodes the
+fields whose status bit is set into 'data'.
+================================================*/
+int COMMB_decode(const adsbFrame *frame, commbData *data){
+	int bds = COMMB_inferBDS(frame);
+
+	memset(data, 0, sizeof(commbData));
+	data->bds = bds;
+
+	switch(bds){
+		case COMMB_BDS40:
+			stats.bds40++;
+			if(MB(frame, 1, 1)){
+				data->selectedAltitude = MB(frame, 2, 12) * 16;
+				data->valid |= COMMB_SEL_ALT;
+			}else if(MB(frame, 14, 1)){
+				data->selectedAltitude = MB(frame, 15, 12) * 16;
+				data->valid |= COMMB_SEL_ALT;
+			}
+			if(MB(frame, 27, 1)){
+				data->baroSetting = 800 + MB(frame, 28, 12) * 0.1f;
+				data->valid |= COMMB_BARO;
+			}
+			break;
+		case COMMB_BDS50:
+			stats.bds50++;
+			if(MB(frame, 1, 1)){
+				data->roll = signedMB(frame, 2, 3, 9) * 45.0f / 256;
+				data->valid |= COMMB_ROLL;
+			}
+			if(MB(frame, 12, 1)){
+				data->track = toAngle360(signedMB(frame, 13, 14, 10) * 90.0f / 512);
+				data->valid |= COMMB_TRACK;
+			}
+			if(MB(frame, 24, 1)){
+				data->groundSpeed = MB(frame, 25, 10) * 2;
+				data->valid |= COMMB_GS;
+			}
+			if(MB(frame, 35, 1)){
+				data->trackRate = signedMB(frame, 36, 37, 9) * 8.0f / 256;
+				data->valid |= COMMB_TRACK_RATE;
+			}
+			if(MB(frame, 46, 1)){
+				data->trueAirspeed = MB(frame, 47, 10) * 2;
+				data->valid |= COMMB_TAS;
+			}
+			break;
+		case COMMB_BDS60:
+			stats.bds60++;
+			if(MB(frame, 1, 1)){
+				data->heading = toAngle360(signedMB(frame, 2, 3, 10) * 90.0f / 512);
+				data->valid |= COMMB_HEADING;
+			}
+			if(MB(frame, 13, 1)){
+				data->indicatedAirspeed = MB(frame, 14, 10);
+				data->valid |= COMMB_IAS;
+			}
+			if(MB(frame, 24, 1)){
+				data->mach = MB(frame, 25, 10) * 2.048f / 512;
+				data->valid |= COMMB_MACH;
+			}
+			if(MB(frame, 35, 1)){
+				data->baroRate = signedMB(frame, 36, 37, 9) * 32;
+				data->valid |= COMMB_BARO_RATE;
+			}
+			if(MB(frame, 46, 1)){
+				data->inertialRate = signedMB(frame, 47, 48, 9) * 32;
+				data->valid |= COMMB_INERTIAL_RATE;
+			}
+			break;
+		case COMMB_AMBIGUOUS:
+			stats.ambiguous++;
+			break;
+		default:
+			stats.unknown++;
+			break;
+	}
+	return bds;
+}
+
+/*==============================================
+FUNCTION: COMMB_getStats
+INPUT: a pointer to commbStats
+OUTPUT: the counters, passed by reference
+================================================*/
+void COMMB_getStats(commbStats *out){
+	*out = stats;
+}
@@ -0,0 +1,99 @@
+#ifndef ADSB_COMMB_H
+#define ADSB_COMMB_H
+
+#include "adsb_frame.h"
+
+/*===============================
+These functions decode the Comm-B
+replies (DF20/21), whose 56-bit MB
+field (bits 32..87) holds one of the
+registers (BDS) of the aircraft.
+The register isn't announced, so it
+is inferred from the status bits
+and the ranges of its fields: a
+field whose status bit is clear
+must be zero, and every field must
+be plausible. Only the registers
+4,0 (selected vertical intention),
+5,0 (track and turn) and 6,0
+(heading and speed) are decoded.
+=================================*/
+
+//Registers (BDS) of the MB field
+#define COMMB_UNKNOWN    0
+#define COMMB_BDS40      0x40
+#define COMMB_BDS50      0x50
+#define COMMB_BDS60      0x60
+#define COMMB_AMBIGUOUS  -1    // more than one register fits
+
+//Fields present in commbData (valid mask)
+#define COMMB_SEL_ALT      0x0001
+#define COMMB_BARO         0x0002
+#define COMMB_ROLL         0x0004
+#define COMMB_TRACK        0x0008
+#define COMMB_GS           0x0010
+#define COMMB_TRACK_RATE   0x0020
+#define COMMB_TAS          0x0040
+#define COMMB_HEADING      0x0080
+#define COMMB_IAS          0x0100
+#define COMMB_MACH         0x0200
+#define COMMB_BARO_RATE    0x0400
+#define COMMB_INERTIAL_RATE 0x0800
+
+/*==================================
+STRUCT: commbData
+DESCRIPTION: the fields of a decoded register; only
+those flagged in 'valid' were transmitted.
+	int bds: COMMB_BDS40, COMMB_BDS50 or COMMB_BDS60.
+	int valid: COMMB_* flags of the fields present.
+	int selectedAltitude: MCP/FCU (or else FMS) selected
+		altitude, in ft (4,0).
+	float baroSetting: barometric pressure setting, in mb (4,0).
+	float roll: roll angle in degrees, right wing down
+		positive (5,0).
+	float track: true track angle in degrees (5,0).
+	int groundSpeed: in knots (5,0).
+	float trackRate: track angle rate in degrees/s (5,0).
+	int trueAirspeed: in knots (5,0).
+	float heading: magnetic heading in degrees (6,0).
+	int indicatedAirspeed: in knots (6,0).
+	float mach: (6,0).
+	int baroRate, inertialRate: vertical rates in ft/min (6,0).
+===================================*/
+typedef struct{
+	int bds;
+	int valid;
+	int selectedAltitude;
+	float baroSetting;
+	float roll;
+	float track;
+	int groundSpeed;
+	float trackRate;
+	int trueAirspeed;
+	float heading;
+	int indicatedAirspeed;
+	float mach;
+	int baroRate;
+	int inertialRate;
+}commbData;
+
+/*==================================
+STRUCT: commbStats
+DESCRIPTION: registers inferred from the Comm-B replies.
+	unsigned long bds40, bds50, bds60: replies decoded.
+	unsigned long ambiguous: replies that fit more than one.
+	unsigned long unknown: replies that fit none.
+===================================*/
+typedef struct{
+	unsigned long bds40;
+	unsigned long bds50;
+	unsigned long bds60;
+	unsigned long ambiguous;
+	unsigned long unknown;
+}commbStats;
+
+int  COMMB_inferBDS(const adsbFrame *frame);
+int  COMMB_decode(const adsbFrame *frame, commbData *data);
+void COMMB_getStats(commbStats *stats);
+
+#endif
@@ -0,0 +1,247 @@
+#include <string.h>
+#include "adsb_crc.h"
+
+/*==============================================
+CRC of each possible byte, i.e. the remainder of
+(byte * x^24) divided by the generator, so the
+division advances 8 bits per lookup.
+================================================*/
+static const uint32_t crcTable[256] = {
+	0x000000, 0xFFF409, 0x001C1B, 0xFFE812, 0x003836, 0xFFCC3F, 0x00242D, 0xFFD024,
+	0x00706C, 0xFF8465, 0x006C77, 0xFF987E, 0x00485A, 0xFFBC53, 0x005441, 0xFFA048,
+	0x00E0D8, 0xFF14D1, 0x00FCC3, 0xFF08CA, 0x00D8EE, 0xFF2CE7, 0x00C4F5, 0xFF30FC,
+	0x0090B4, 0xFF64BD, 0x008CAF, 0xFF78A6, 0x00A882, 0xFF5C8B, 0x00B499, 0xFF4090,
+	0x01C1B0, 0xFE35B9, 0x01DDAB, 0xFE29A2, 0x01F986, 0xFE0D8F, 0x01E59D, 0xFE1194,
+	0x01B1DC, 0xFE45D5, 0x01ADC7, 0xFE59CE, 0x0189EA, 0xFE7DE3, 0x0195F1, 0xFE61F8,
+	0x012168, 0xFED561, 0x013D73, 0xFEC97A, 0x01195E, 0xFEED57, 0x010545, 0xFEF14C,
+	0x015104, 0xFEA50D, 0x014D1F, 0xFEB916, 0x016932, 0xFE9D3B, 0x017529, 0xFE8120,
+	0x038360, 0xFC7769, 0x039F7B, 0xFC6B72, 0x03BB56, 0xFC4F5F, 0x03A74D, 0xFC5344,
+	0x03F30C, 0xFC0705, 0x03EF17, 0xFC1B1E, 0x03CB3A, 0xFC3F33, 0x03D721, 0xFC2328,
+	0x0363B8, 0xFC97B1, 0x037FA3, 0xFC8BAA, 0x035B8E, 0xFCAF87, 0x034795, 0xFCB39C,
+	0x0313D4, 0xFCE7DD, 0x030FCF, 0xFCFBC6, 0x032BE2, 0xFCDFEB, 0x0337F9, 0xFCC3F0,
+	0x0242D0, 0xFDB6D9, 0x025ECB, 0xFDAAC2, 0x027AE6, 0xFD8EEF, 0x0266FD, 0xFD92F4,
+	0x0232BC, 0xFDC6B5, 0x022EA7, 0xFDDAAE, 0x020A8A, 0xFDFE83, 0x021691, 0xFDE298,
+	0x02A208, 0xFD5601, 0x02BE13, 0xFD4A1A, 0x029A3E, 0xFD6E37, 0x028625, 0xFD722C,
+	0x02D264, 0xFD266D, 0x02CE7F, 0xFD3A76, 0x02EA52, 0xFD1E5B, 0x02F649, 0xFD0240,
+	0x0706C0, 0xF8F2C9, 0x071ADB, 0xF8EED2, 0x073EF6, 0xF8CAFF, 0x0722ED, 0xF8D6E4,
+	0x0776AC, 0xF882A5, 0x076AB7, 0xF89EBE, 0x074E9A, 0xF8BA93, 0x075281, 0xF8A688,
+	0x07E618, 0xF81211, 0x07FA03, 0xF80E0A, 0x07DE2E, 0xF82A27, 0x07C235, 0xF8363C,
+	0x079674, 0xF8627D, 0x078A6F, 0xF87E66, 0x07AE42, 0xF85A4B, 0x07B259, 0xF84650,
+	0x06C770, 0xF93379, 0x06DB6B, 0xF92F62, 0x06FF46, 0xF90B4F, 0x06E35D, 0xF91754,
+	0x06B71C, 0xF94315, 0x06AB07, 0xF95F0E, 0x068F2A, 0xF97B23, 0x069331, 0xF96738,
+	0x0627A8, 0xF9D3A1, 0x063BB3, 0xF9CFBA, 0x061F9E, 0xF9EB97, 0x060385, 0xF9F78C,
+	0x0657C4, 0xF9A3CD, 0x064BDF, 0xF9BFD6, 0x066FF2, 0xF99BFB, 0x0673E9, 0xF987E0,
+	0x0485A0, 0xFB71A9, 0x0499BB, 0xFB6DB2, 0x04BD96, 0xFB499F, 0x04A18D, 0xFB5584,
+	0x04F5CC, 0xFB01C5, 0x04E9D7, 0xFB1DDE, 0x04CDFA, 0xFB39F3, 0x04D1E1, 0xFB25E8,
+	0x046578, 0xFB9171, 0x047963, 0xFB8D6A, 0x045D4E, 0xFBA947, 0x044155, 0xFBB55C,
+	0x041514, 0xFBE11D, 0x04090F, 0xFBFD06, 0x042D22, 0xFBD92B, 0x043139, 0xFBC530,
+	0x054410, 0xFAB019, 0x05580B, 0xFAAC02, 0x057C26, 0xFA882F, 0x05603D, 0xFA9434,
+	0x05347C, 0xFAC075, 0x052867, 0xFADC6E, 0x050C4A, 0xFAF843, 0x051051, 0xFAE458,
+	0x05A4C8, 0xFA50C1, 0x05B8D3, 0xFA4CDA, 0x059CFE, 0xFA68F7, 0x0580E5, 0xFA74EC,
+	0x05D4A4, 0xFA20AD, 0x05C8BF, 0xFA3CB6, 0x05EC92, 0xFA189B, 0x05F089, 0xFA0480
+};
+
+/*==================================
+STRUCT: crcFix
+DESCRIPTION: one entry of a syndrome table.
+	uint32_t syndrome: the key; 0 marks an empty slot.
+	uint8_t bit[2]: the bits to be flipped, from the MSB.
+	uint8_t errors: 1 or 2, 0 if the syndrome is ambiguous.
+===================================*/
+typedef struct{
+	uint32_t syndrome;
+	uint8_t bit[2];
+	uint8_t errors;
+}crcFix;
+
+//Open-addressing tables, less than half full so the probes are short
+#define CRC_SHORT_SLOTS  4096
+#define CRC_LONG_SLOTS   16384
+
+static crcFix shortFixes[CRC_SHORT_SLOTS];
+static crcFix longFixes[CRC_LONG_SLOTS];
+static crcStats shortStats, longStats;
+static int fixesReady = 0;
+
+static inline uint32_t CRC_hash(uint32_t syndrome, int slots){
+	return ((syndrome * 2654435761u) >> 16) & (slots - 1);
+}
+
+/*==============================================
+FUNCTION: CRC_addFix
+INPUT: a table, its size and stats, a syndrome and
+the error pattern that causes it
+OUTPUT: void
+DESCRIPTION: inserts the pattern. If the syndrome is
+already there with a different pattern, the entry
+is marked ambiguous.
+================================================*/
+static void CRC_addFix(crcFix *table, int slots, crcStats *stats, uint32_t syndrome, int bit0, int bit1){
+	uint32_t h = CRC_hash(syndrome, slots);
+
+	while(table[h].syndrome != 0){
+		if(table[h].syndrome == syndrome){
+			if(table[h].errors != 0){
+				table[h].errors = 0;
+				stats->ambiguous++;
+			}
+			return;
+		}
+		h = (h + 1) & (slots - 1);
+	}
+
+	table[h].syndrome = syndrome;
+	table[h].bit[0] = (uint8_t)bit0;
+	table[h].bit[1] = (uint8_t)((bit1 < 0) ? bit0 : bit1);
+	table[h].errors = (bit1 < 0) ? 1 : 2;
+	if(bit1 < 0){
+		stats->singles++;
+	}else{
+		stats->doubles++;
+	}
+}
+
+/*==============================================
+FUNCTION: CRC_buildFixes
+INPUT: a table, its size and stats and the frame
+length
+OUTPUT: void
+DESCRIPTION: the CRC is linear, so the syndrome of a
+2-bit error is the XOR of the two 1-bit syndromes.
+================================================*/
+static void CRC_buildFixes(crcFix *table, int slots, crcStats *stats, int bits){
+	uint32_t single[CRC_LONG_BITS];
+	uint8_t msg[CRC_LONG_BITS / 8];
+	int i = 0, j = 0;
+
+	memset(table, 0, slots * sizeof(crcFix));
+	memset(stats, 0, sizeof(crcStats));
+
+	for(i = 0; i < bits; i++){
+		memset(msg, 0, sizeof(msg));
+		msg[i / 8] = (uint8_t)(0x80 >> (i % 8));
+		single[i] = CRC_syndrome(msg, bits);
+	}
+	for(i = CRC_DF_BITS; i < bits; i++){
+		CRC_addFix(table, slots, stats, single[i], i, -1);
+	}
+	for(i = CRC_DF_BITS; i < bits; i++){
+		for(j = i + 1; j < bits; j++){
+			CRC_addFix(table, slots, stats, single[i] ^ single[j], i, j);
+		}
+	}
+}
+
+/*==============================================
+FUNCTION: CRC_init
+INPUT: void
+OUTPUT: void
+DESCRIPTION: builds the syndrome tables of the 56-bit
+and the 112-bit frames. It is called by the first
+CRC_fixFrame() if it wasn't called before.
+================================================*/
+void CRC_init(void){
+	if(!fixesReady){
+		CRC_buildFixes(shortFixes, CRC_SHORT_SLOTS, &shortStats, CRC_SHORT_BITS);
+		CRC_buildFixes(longFixes, CRC_LONG_SLOTS, &longStats, CRC_LONG_BITS);
+		fixesReady = 1;
+	}
+}
+
+/*==============================================
+FUNCTION: CRC_frameBits
+INPUT: a packed frame
+OUTPUT: 56 or 112
+DESCRIPTION: returns the length of the frame from
+its downlink format: DF 0 to 15 are short frames,
+DF 16 and above are long ones.
+================================================*/
+int CRC_frameBits(const uint8_t *msg){
+	return (msg[0] & 0x80) ? CRC_LONG_BITS : CRC_SHORT_BITS;
+}
+
+/*==============================================
+FUNCTION: CRC_checksum
+INPUT: a packed frame and its length in bits
+OUTPUT: a 24-bit integer
+DESCRIPTION: returns the parity of the frame, i.e.
+the CRC of all its bits but the last 24 (the
+parity field itself).
+================================================*/
+uint32_t CRC_checksum(const uint8_t *msg, int bits){
+	uint32_t crc = 0;
+	int i = 0;
+
+	for(i = 0; i < (bits - CRC_PARITY_BITS) / 8; i++){
+		crc = ((crc << 8) & 0xFFFFFF) ^ crcTable[((crc >> 16) ^ msg[i]) & 0xFF];
+	}
+	return crc;
+}
+
+/*==============================================
+FUNCTION: CRC_syndrome
+INPUT: a packed frame and its length in bits
+OUTPUT: a 24-bit integer
+DESCRIPTION: returns the checksum XOR the parity
+field. It is zero for a correct DF17/DF18 frame and
+the ICAO address for the frames whose parity is
+overlaid with it (DF 0, 4, 5, 16, 20, 21, 24). A
+non-zero value that isn't expected is the signature
+of the bit errors (see CRC_fixFrame).
+================================================*/
+uint32_t CRC_syndrome(const uint8_t *msg, int bits){
+	const uint8_t *p = &msg[(bits - CRC_PARITY_BITS) / 8];
+	uint32_t parity = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+
+	return CRC_checksum(msg, bits) ^ parity;
+}
+
+/*==============================================
+FUNCTION: CRC_fixFrame
+INPUT: a packed frame, its length in bits, its
+syndrome and the maximum number of bits to correct
+OUTPUT: the number of bits corrected (0 to 2) or
+CRC_UNFIXABLE
+DESCRIPTION: looks the syndrome up in the table of
+the frame length and, if it is the signature of an
+unambiguous error of up to max_errors bits, flips
+those bits. The frame is left untouched otherwise.
+================================================*/
+int CRC_fixFrame(uint8_t *msg, int bits, uint32_t syndrome, int max_errors){
+	const crcFix *table = (bits == CRC_SHORT_BITS) ? shortFixes : longFixes;
+	int slots = (bits == CRC_SHORT_BITS) ? CRC_SHORT_SLOTS : CRC_LONG_SLOTS;
+	uint32_t h = 0;
+
+	if(syndrome == 0){
+		return 0;
+	}
+	if(max_errors <= 0){
+		return CRC_UNFIXABLE;
+	}
+	CRC_init();
+
+	h = CRC_hash(syndrome, slots);
+	while((table[h].syndrome != 0) && (table[h].syndrome != syndrome)){
+		h = (h + 1) & (slots - 1);
+	}
+	if((table[h].syndrome == 0) || (table[h].errors == 0) || (table[h].errors > max_errors)){
+		return CRC_UNFIXABLE;
+	}
+
+	msg[table[h].bit[0] / 8] ^= (uint8_t)(0x80 >> (table[h].bit[0] % 8));
+	if(table[h].errors == 2){
+		msg[table[h].bit[1] / 8] ^= (uint8_t)(0x80 >> (table[h].bit[1] % 8));
+	}
+	return table[h].errors;
+}
+
+/*==============================================
+FUNCTION: CRC_getStats
+INPUT: a frame length and a pointer to crcStats
+OUTPUT: the contents of its table, passed by
+reference
+================================================*/
+void CRC_getStats(int bits, crcStats *stats){
+	CRC_init();
+	*stats = (bits == CRC_SHORT_BITS) ? shortStats : longStats;
+}
@@ -0,0 +1,50 @@
+#ifndef ADSB_CRC_H
+#define ADSB_CRC_H
+
+#include <stdint.h>
+
+/*===============================
+These functions are responsible
+for the Mode-S parity check (CRC-24,
+generator 0x1FFF409) on frames in
+their packed binary form: 7 bytes
+for the 56-bit frames and 14 bytes
+for the 112-bit ones, MSB first.
+=================================*/
+
+#define CRC_SHORT_BITS   56
+#define CRC_LONG_BITS    112
+#define CRC_PARITY_BITS  24
+
+//Error correction: the syndrome of every 1-bit and 2-bit error is
+//precomputed in a hash table per frame length. The 5 bits of the
+//downlink format are never corrected, so a fix can't turn a frame
+//into another format.
+#define CRC_MAX_ERRORS   2
+#define CRC_DF_BITS      5
+
+//Status Macros
+#define CRC_UNFIXABLE   -1
+
+/*==================================
+STRUCT: crcStats
+DESCRIPTION:
+	int singles: 1-bit error syndromes in the tables.
+	int doubles: 2-bit error syndromes in the tables.
+	int ambiguous: syndromes shared by more than one error
+		pattern; they are never corrected.
+===================================*/
+typedef struct{
+	int singles;
+	int doubles;
+	int ambiguous;
+}crcStats;
+
+void     CRC_init(void);
+int      CRC_frameBits(const uint8_t *msg);
+uint32_t CRC_checksum(const uint8_t *msg, int bits);
+uint32_t CRC_syndrome(const uint8_t *msg, int bits);
+int      CRC_fixFrame(uint8_t *msg, int bits, uint32_t syndrome, int max_errors);
+void     CRC_getStats(int bits, crcStats *stats);
+
+#endif
@@ -2,14 +2,138 @@
 #include <sqlite3.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include "adsb_lists.h"   // must define adsbMsg with NACp,NACv,NIC,SIL,SDA
+#include "adsb_aircraft.h"
+#include "adsb_userInfo.h"
 #include "adsb_time.h"
 #include "adsb_db.h"
 #include "adsb_createLog.h"
 #include "board_monitor.h"
 
-#define DATABASE_ERROR -1
-#define DATABASE "radarlivre_v4.db"
+/*==================================
+STRUCT: dbRow
+DESCRIPTION: a row waiting to be inserted, a copy of
+the aircraft taken when it was saved, so the decoder
+can go on updating it.
+    int table: DB_ADSBINFO, DB_AIRLINE or DB_METRICS.
+    double now: when the row was saved.
+    adsbMsg msg, adsbCold cold: the aircraft (DB_ADSBINFO,
+        DB_AIRLINE).
+    double userCpu, sysCpu, long maxRss: the system
+        metrics (DB_METRICS).
+===================================*/
+typedef struct{
+    int table;
+    double now;
+    adsbMsg msg;
+    adsbCold cold;
+    double userCpu;
+    double sysCpu;
+    long maxRss;
+}dbRow;
+
+enum{DB_ADSBINFO,DB_AIRLINE,DB_METRICS,DB_TABLES};
+
+//The insert of each table and the function named in the logs
+static const struct{
+    const char *name;
+    const char *sql;
+    char *source;
+}tables[DB_TABLES]={
+    {"radarlivre_api_adsbinfo",
+     "INSERT INTO radarlivre_api_adsbinfo("
+     "collectorKey, modeSCode, callsign, latitude, longitude, altitude,"
+     "verticalVelocity, horizontalVelocity, groundTrackHeading, timestamp,"
+     "timestampSent, messageDataId, messageDataPositionEven, messageDataPositionOdd,"
+     "messageDataVelocity, NACp, NACv, NIC, SIL, SDA"
+     ") VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);",
+     "DB_saveADSBInfo"},
+    {"radarlivre_api_airline",
+     "INSERT INTO radarlivre_api_airline(icao,callsign) VALUES(?,?) ON CONFLICT DO NOTHING;",
+     "DB_saveAirline"},
+    {"system_metrics",
+     "INSERT INTO system_metrics(timestamp, user_cpu, sys_cpu, max_rss) VALUES(?,?,?,?);",
+     "DB_saveSystemMetrics"}
+};
+
+/*==================================
+STRUCT: dbContext
+DESCRIPTION:
+    sqlite3 *db: the connection, opened once by DB_init().
+    sqlite3_stmt *stmt[]: the insert of each table, prepared
+        on its first use and then only bound, stepped and
+        reset for every row.
+    int wal: the journal is in WAL mode.
+===================================*/
+typedef struct{
+    sqlite3 *db;
+    sqlite3_stmt *stmt[DB_TABLES];
+    int wal;
+}dbContext;
+
+static dbContext context;
+
+//Applied by DB_init(), see DB_configure()
+static dbConfig config={
+    DB_DEFAULT_SYNCHRONOUS,DB_DEFAULT_CACHE_KB,DB_DEFAULT_MMAP_MB,
+    DB_DEFAULT_BUSY_MS,DB_DEFAULT_CHECKPOINT_MS
+};
+
+/*==================================
+The queue of the writer is a ring of rows
+filled by any thread that saves (producers)
+and emptied only by the writer thread, which
+takes up to batchRows rows at once and inserts
+them in one transaction. The producers never
+wait: if the ring is full the row is dropped.
+===================================*/
+static struct{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+
+    dbRow *rows;
+    dbRow *batch;       //the rows being inserted, owned by the writer
+    int length;
+    int batchRows;
+    int batchMs;
+    int head;           //next row to be written by the producers
+    int tail;           //next row to be read by the writer
+    int count;          //queued rows
+
+    int running;
+    dbStats stats;
+}writer;
+
+/*==================================
+STRUCT: airlinePair
+DESCRIPTION: an icao/callsign pair already saved.
+    uint32_t address: the 24-bit address plus 1, so 0 is an
+        empty slot.
+    char callsign[8]: the callsign, padded with '\0'.
+===================================*/
+typedef struct{
+    uint32_t address;
+    char callsign[8];
+}airlinePair;
+
+/*==================================
+The pairs already saved in radarlivre_api_airline,
+in an open addressing table of DB_SEEN_SIZE slots,
+so a repeated pair isn't even queued. The table is
+emptied when it is 3/4 full: the pairs saved again
+afterwards are discarded by the unique index.
+===================================*/
+static struct{
+    pthread_mutex_t lock;
+    airlinePair slots[DB_SEEN_SIZE];
+    int count;
+    unsigned long skipped;
+}seen={.lock=PTHREAD_MUTEX_INITIALIZER};
 
 /*==============================================
 FUNCTION: DB_open
@@ -58,120 +182,421 @@ void DB_close(sqlite3 **db_handler,char**errmsg,char**sqlText){
 }
 
 /*==============================================
-FUNCTION: DB_saveADSBInfo
-INPUT: pointer to adsbMsg
-OUTPUT: int status (0=OK)
-DESCRIPTION: inserts data into radarlivre_api_adsbinfo,
-including NACp,NACv,NIC,SIL,SDA columns.
+FUNCTION: DB_configure
+INPUT: a pointer to dbConfig
+OUTPUT: DATABASE_OK or DATABASE_ERROR
+DESCRIPTION: sets the pragmas applied when the
+connection is opened (call it before DB_init()).
+An unknown synchronous mode or a negative size is
+refused and the configuration is kept.
 ================================================*/
-int DB_saveADSBInfo(adsbMsg *msg){
-    sqlite3 *db_handler=NULL;
-    char *sqlText=NULL,*errmsg=NULL;
-    int status=-1;
+int DB_configure(const dbConfig *newConfig){
+    static const char *const modes[]={"OFF","NORMAL","FULL","EXTRA"};
+    int i=0;
+
+    for(i=0;i<4;i++){
+        if(strcasecmp(newConfig->synchronous,modes[i])==0){
+            break;
+        }
+    }
+    if((i==4)||(newConfig->cacheKb<0)||(newConfig->mmapMb<0)||
+       (newConfig->busyMs<0)||(newConfig->checkpointMs<0)){
+        return DATABASE_ERROR;
+    }
+    config=*newConfig;
+    config.synchronous=modes[i];
+    return DATABASE_OK;
+}
+
+/*==============================================
+FUNCTION: DB_pragmas
+INPUT: void
+OUTPUT: void
+DESCRIPTION: switches the journal to WAL, so the
+readers of the database (e.g. sqlite_exporter.sh)
+and the inserts don't block each other, and applies
+the configuration. A pragma that fails is logged
+and the database is used with its default.
+================================================*/
+static void DB_pragmas(void){
+    sqlite3_stmt *stmt=NULL;
+    char sql[160];
 
+    sqlite3_busy_timeout(context.db,config.busyMs);
+
+    //journal_mode returns the mode in use, which stays the old one if WAL can't be set
+    context.wal=0;
+    if(sqlite3_prepare_v2(context.db,"PRAGMA journal_mode=WAL;",-1,&stmt,NULL)==SQLITE_OK){
+        if(sqlite3_step(stmt)==SQLITE_ROW){
+            context.wal=(strcasecmp((const char*)sqlite3_column_text(stmt,0),"wal")==0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    if(!context.wal){
+        printf("WAL couldn't be enabled: %s\n",sqlite3_errmsg(context.db));
+        LOG_add("DB_pragmas","WAL couldn't be enabled");
+    }
+
+    snprintf(sql,sizeof(sql),
+             "PRAGMA synchronous=%s; PRAGMA cache_size=-%d; PRAGMA mmap_size=%lld;"
+             "PRAGMA journal_size_limit=%d;",
+             config.synchronous,config.cacheKb,(long long)config.mmapMb<<20,DB_WAL_SIZE_LIMIT);
+    if(sqlite3_exec(context.db,sql,NULL,NULL,NULL)!=SQLITE_OK){
+        printf("Database pragmas couldn't be set: %s\n",sqlite3_errmsg(context.db));
+        LOG_add("DB_pragmas","pragmas couldn't be set");
+    }
+}
+
+/*==============================================
+FUNCTION: DB_uniqueAirline
+INPUT: void
+OUTPUT: void
+DESCRIPTION: the first time the database is opened,
+removes the repeated icao/callsign pairs of
+radarlivre_api_airline (the first row of each pair
+is kept) and creates a unique index on them, so the
+inserts of a pair already there do nothing.
+================================================*/
+static void DB_uniqueAirline(void){
+    sqlite3_stmt *stmt=NULL;
+    int exists=0,removed=0;
+
+    if(sqlite3_prepare_v2(context.db,
+         "SELECT 1 FROM sqlite_master WHERE type='index' AND name='radarlivre_api_airline_icao_callsign';",
+         -1,&stmt,NULL)==SQLITE_OK){
+        exists=(sqlite3_step(stmt)==SQLITE_ROW);
+        sqlite3_finalize(stmt);
+    }
+    if(exists){
+        return;
+    }
+
+    sqlite3_exec(context.db,"BEGIN;",NULL,NULL,NULL);
+    if(sqlite3_exec(context.db,
+         "DELETE FROM radarlivre_api_airline WHERE icao IS NOT NULL AND callsign IS NOT NULL AND id NOT IN"
+         " (SELECT MIN(id) FROM radarlivre_api_airline GROUP BY icao,callsign);",
+         NULL,NULL,NULL)==SQLITE_OK){
+        removed=sqlite3_changes(context.db);
+    }
+    if(sqlite3_exec(context.db,
+         "CREATE UNIQUE INDEX radarlivre_api_airline_icao_callsign"
+         " ON radarlivre_api_airline(icao,callsign);",
+         NULL,NULL,NULL)!=SQLITE_OK||
+       sqlite3_exec(context.db,"COMMIT;",NULL,NULL,NULL)!=SQLITE_OK){
+        printf("Airline index couldn't be created: %s\n",sqlite3_errmsg(context.db));
+        LOG_add("DB_uniqueAirline","airline index couldn't be created");
+        sqlite3_exec(context.db,"ROLLBACK;",NULL,NULL,NULL);
+        return;
+    }
+    printf("Airline index created, %d repeated rows removed.\n",removed);
+    LOG_add("DB_uniqueAirline","airline index created");
+}
+
+/*==============================================
+FUNCTION: DB_init
+INPUT: a char pointer (db_name)
+OUTPUT: DATABASE_OK or DATABASE_ERROR
+DESCRIPTION: opens the connection used by all the
+DB_save* functions, once at startup, and applies the
+pragmas (see DB_pragmas()) and the airline index
+(see DB_uniqueAirline()). If it isn't
+called (or fails), the first save tries again with
+DATABASE. The statements are prepared when first
+used, so a missing table only fails its own inserts.
+================================================*/
+int DB_init(char *db_name){
+    if(context.db){
+        return DATABASE_OK;
+    }
     sqlite3_initialize();
-    db_handler=DB_open(DATABASE);
-    if(!db_handler){
-        sqlite3_shutdown();
+    context.db=DB_open(db_name);
+    if(!context.db){
         return DATABASE_ERROR;
     }
+    DB_pragmas();
+    DB_uniqueAirline();
+    return DATABASE_OK;
+}
+
+/*==============================================
+FUNCTION: DB_shutdown
+INPUT: void
+OUTPUT: void
+DESCRIPTION: finalizes the statements and closes
+the connection opened by DB_init(). The writer
+must be stopped first.
+================================================*/
+void DB_shutdown(void){
+    char *errmsg=NULL,*sqlText=NULL;
+    int i=0;
 
-    sqlText=sqlite3_mprintf(
-      "INSERT INTO radarlivre_api_adsbinfo("
-      "collectorKey, modeSCode, callsign, latitude, longitude, altitude,"
-      "verticalVelocity, horizontalVelocity, groundTrackHeading, timestamp,"
-      "timestampSent, messageDataId, messageDataPositionEven, messageDataPositionOdd,"
-      "messageDataVelocity, NACp, NACv, NIC, SIL, SDA"
-      ") VALUES("
-      "\"%q\",\"%q\",\"%q\",%f,%f,%d,%d,%f,%f,%lf,%lf,\"%q\",\"%q\",\"%q\",\"%q\",%d,%d,%d,%d,%d);",
-      msg->COLLECTOR_ID[0]?msg->COLLECTOR_ID:"defaultColl",
-      msg->ICAO,
-      msg->callsign,
-      msg->Latitude,
-      msg->Longitude,
-      msg->Altitude,
-      msg->verticalVelocity,
-      msg->horizontalVelocity,
-      msg->groundTrackHeading,
-      msg->oeTimestamp[0],
-      msg->oeTimestamp[1],
-      msg->messageID,
-      msg->oeMSG[0],
-      msg->oeMSG[1],
-      msg->mensagemVEL,
-      msg->NACp,
-      msg->NACv,
-      msg->NIC,
-      msg->SIL,
-      msg->SDA
-    );
-    if(!sqlText){
-        printf("Query couldn't be created!\n");
-        LOG_add("DB_saveADSBInfo","query couldn't be created");
-        DB_close(&db_handler,&errmsg,&sqlText);
+    for(i=0;i<DB_TABLES;i++){
+        sqlite3_finalize(context.stmt[i]);
+        context.stmt[i]=NULL;
+    }
+    if(context.db){
+        DB_close(&context.db,&errmsg,&sqlText);
         sqlite3_shutdown();
+    }
+}
+
+/*==============================================
+FUNCTION: DB_statement
+INPUT: a table (DB_ADSBINFO, DB_AIRLINE, DB_METRICS)
+OUTPUT: its insert ready to be bound, or NULL
+DESCRIPTION: opens the connection and prepares the
+statement if this wasn't done yet.
+================================================*/
+static sqlite3_stmt* DB_statement(int table){
+    sqlite3_stmt **stmt=&context.stmt[table];
+
+    if(!context.db && DB_init(DATABASE)!=DATABASE_OK){
+        return NULL;
+    }
+    if(!*stmt && sqlite3_prepare_v2(context.db,tables[table].sql,-1,stmt,NULL)!=SQLITE_OK){
+        printf("Query couldn't be created: %s\n",sqlite3_errmsg(context.db));
+        LOG_add(tables[table].source,"query couldn't be created");
+        *stmt=NULL;
+    }
+    return *stmt;
+}
+
+/*==============================================
+FUNCTION: DB_frameHex
+INPUT: pointer to adsbMsg, the MSG_* bit of a frame,
+the frame and a char vector of FRAME_HEX_LEN+1
+OUTPUT: the frame as hex, or "" if it isn't kept
+================================================*/
+static void DB_frameHex(const adsbMsg *msg,int bit,const adsbFrame *frame,char *hex){
+    if(msg->frames&bit){
+        FRAME_toHex(frame,FRAME_LONG_BITS,hex);
+    }else{
+        hex[0]='\0';
+    }
+}
+
+/*==============================================
+FUNCTION: DB_bindADSBInfo
+INPUT: the insert of radarlivre_api_adsbinfo and a row
+OUTPUT: void
+DESCRIPTION: binds the columns, including NACp,NACv,
+NIC,SIL,SDA. The address, the timestamps and the
+frames kept in binary are converted to the text the
+table has always held.
+================================================*/
+static void DB_bindADSBInfo(sqlite3_stmt *stmt,const dbRow *row){
+    const adsbMsg *msg=&row->msg;
+    const adsbCold *cold=&row->cold;
+    char icao[7];
+    char frames[4][FRAME_HEX_LEN+1];
+
+    snprintf(icao,sizeof(icao),"%06X",msg->address);
+    DB_frameHex(msg,MSG_ID,&cold->messageID,frames[0]);
+    DB_frameHex(msg,MSG_EVEN,&cold->oeMSG[0],frames[1]);
+    DB_frameHex(msg,MSG_ODD,&cold->oeMSG[1],frames[2]);
+    DB_frameHex(msg,MSG_VEL,&cold->mensagemVEL,frames[3]);
+
+    sqlite3_bind_text(stmt,1,collectorId[0]?collectorId:"defaultColl",-1,SQLITE_STATIC);
+    sqlite3_bind_text(stmt,2,icao,-1,SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt,3,cold->callsign,-1,SQLITE_STATIC);
+    sqlite3_bind_double(stmt,4,msg->Latitude);
+    sqlite3_bind_double(stmt,5,msg->Longitude);
+    sqlite3_bind_int(stmt,6,msg->Altitude);
+    sqlite3_bind_int(stmt,7,msg->verticalVelocity);
+    sqlite3_bind_double(stmt,8,MSG_speed(msg));
+    sqlite3_bind_double(stmt,9,MSG_heading(msg));
+    sqlite3_bind_double(stmt,10,msg->oeTimestamp[0]?TIME_fromTicks(msg->oeTimestamp[0],row->now):0.0);
+    sqlite3_bind_double(stmt,11,msg->oeTimestamp[1]?TIME_fromTicks(msg->oeTimestamp[1],row->now):0.0);
+    sqlite3_bind_text(stmt,12,frames[0],-1,SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt,13,frames[1],-1,SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt,14,frames[2],-1,SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt,15,frames[3],-1,SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt,16,cold->NACp);
+    sqlite3_bind_int(stmt,17,cold->NACv);
+    sqlite3_bind_int(stmt,18,cold->NIC);
+    sqlite3_bind_int(stmt,19,cold->SIL);
+    sqlite3_bind_int(stmt,20,cold->SDA);
+}
+
+/*==============================================
+FUNCTION: DB_insert
+INPUT: a row
+OUTPUT: SQLITE_OK or the error of the insert
+DESCRIPTION: binds the row to the insert of its
+table, runs it and resets the statement for the
+next row. The text of the row is only read by
+sqlite3_step(), so it isn't copied.
+================================================*/
+static int DB_insert(const dbRow *row){
+    sqlite3_stmt *stmt=DB_statement(row->table);
+    int status=-1;
+
+    if(!stmt){
         return DATABASE_ERROR;
     }
+    switch(row->table){
+        case DB_ADSBINFO:
+            DB_bindADSBInfo(stmt,row);
+            break;
+        case DB_AIRLINE: {
+            char icao[7];
+            snprintf(icao,sizeof(icao),"%06X",row->msg.address);
+            sqlite3_bind_text(stmt,1,icao,-1,SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt,2,row->cold.callsign,-1,SQLITE_STATIC);
+            break;
+        }
+        case DB_METRICS:
+            sqlite3_bind_int64(stmt,1,(long)row->now);
+            sqlite3_bind_double(stmt,2,row->userCpu);
+            sqlite3_bind_double(stmt,3,row->sysCpu);
+            sqlite3_bind_int64(stmt,4,row->maxRss);
+            break;
+    }
+
+    status=sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return (status==SQLITE_DONE)?SQLITE_OK:status;
+}
 
-    status=sqlite3_exec(db_handler,sqlText,NULL,NULL,&errmsg);
+/*==============================================
+FUNCTION: DB_save
+INPUT: a row
+OUTPUT: int status (0=OK)
+DESCRIPTION: if the writer is running, queues the
+row for it (DATABASE_ERROR if the queue is full);
+otherwise inserts it at once.
+================================================*/
+static int DB_save(const dbRow *row){
+    int status=-1,queued=0;
+
+    if(writer.rows){
+        pthread_mutex_lock(&writer.lock);
+        if(writer.count<writer.length){
+            writer.rows[writer.head]=*row;
+            writer.head=(writer.head+1)%writer.length;
+            writer.count++;
+            writer.stats.queued++;
+            if((unsigned long)writer.count>writer.stats.maxUsed){
+                writer.stats.maxUsed=writer.count;
+            }
+            //wake the writer for the first row of a batch and when one is full
+            if((writer.count==1)||(writer.count==writer.batchRows)){
+                pthread_cond_signal(&writer.filled);
+            }
+            queued=1;
+        }else{
+            writer.stats.dropped++;
+        }
+        pthread_mutex_unlock(&writer.lock);
+        return queued?0:DATABASE_ERROR;
+    }
+
+    status=DB_insert(row);
     if(status==SQLITE_OK){
-        printf("Data was saved successfully into radarlivre_api_adsbinfo!\n");
-        LOG_add("DB_saveADSBInfo","Data saved successfully");
+        printf("Data was saved successfully into %s!\n",tables[row->table].name);
+        LOG_add(tables[row->table].source,"Data saved successfully");
     } else {
-        printf("Data couldn't be saved: %s\n",errmsg?errmsg:"Unknown Err");
-        LOG_add("DB_saveADSBInfo","Data couldn't be saved");
+        printf("Data couldn't be saved: %s\n",context.db?sqlite3_errmsg(context.db):"Unknown Err");
+        LOG_add(tables[row->table].source,"Data couldn't be saved");
     }
-
-    DB_close(&db_handler,&errmsg,&sqlText);
-    sqlite3_shutdown();
     return status;
 }
 
+//A row of the aircraft, copied when it is saved
+static void DB_aircraftRow(dbRow *row,int table,adsbMsg *msg){
+    row->table=table;
+    row->now=getCurrentTime();
+    row->msg=*msg;
+    row->cold=*AIRCRAFT_cold(msg);
+}
+
+/*==============================================
+FUNCTION: DB_saveADSBInfo
+INPUT: pointer to adsbMsg
+OUTPUT: int status (0=OK)
+DESCRIPTION: inserts data into radarlivre_api_adsbinfo
+(see DB_bindADSBInfo).
+================================================*/
+int DB_saveADSBInfo(adsbMsg *msg){
+    dbRow row;
+
+    DB_aircraftRow(&row,DB_ADSBINFO,msg);
+    return DB_save(&row);
+}
+
+/*==============================================
+FUNCTION: DB_seenSlot
+INPUT: a pair (seen.lock held)
+OUTPUT: the slot of the pair, or the empty slot
+where it would be added
+DESCRIPTION: linear probing from an FNV-1a hash of
+the address and the callsign. The table is never
+more than 3/4 full, so an empty slot is reached.
+================================================*/
+static airlinePair* DB_seenSlot(const airlinePair *pair){
+    const unsigned char *bytes=(const unsigned char*)pair;
+    uint32_t hash=2166136261u;
+    unsigned i=0;
+
+    for(i=0;i<sizeof(airlinePair);i++){
+        hash=(hash^bytes[i])*16777619u;
+    }
+    for(i=hash&(DB_SEEN_SIZE-1);;i=(i+1)&(DB_SEEN_SIZE-1)){
+        if((seen.slots[i].address==0)||(memcmp(&seen.slots[i],pair,sizeof(airlinePair))==0)){
+            return &seen.slots[i];
+        }
+    }
+}
+
 /*==============================================
 FUNCTION: DB_saveAirline
 INPUT: pointer to adsbMsg
 OUTPUT: int status
 DESCRIPTION: inserts the icao & callsign into 
-radarlivre_api_airline table
+radarlivre_api_airline table, unless the pair was
+already saved by this process (then it returns 0
+at once). A pair is only marked as saved once its
+row was inserted or queued.
 ================================================*/
 int DB_saveAirline(adsbMsg *msg){
-    sqlite3 *db_handler=NULL;
-    char *sqlText=NULL,*errmsg=NULL;
+    airlinePair pair;
+    airlinePair *slot=NULL;
+    const char *callsign=NULL;
+    dbRow row;
     int status=-1;
 
-    sqlite3_initialize();
-    db_handler=DB_open(DATABASE);
-    if(!db_handler){
-        sqlite3_shutdown();
-        return DATABASE_ERROR;
-    }
+    memset(&pair,0,sizeof(pair));
+    pair.address=msg->address+1;
+    callsign=AIRCRAFT_cold(msg)->callsign;
+    memcpy(pair.callsign,callsign,strnlen(callsign,sizeof(pair.callsign)));
 
-    sqlText=sqlite3_mprintf(
-      "INSERT INTO radarlivre_api_airline(icao,callsign)"
-      "VALUES(\"%q\",\"%q\");",
-      msg->ICAO,
-      msg->callsign
-    );
-    if(!sqlText){
-        printf("Query couldn't be created!\n");
-        LOG_add("DB_saveAirline","query couldn't be created");
-        DB_close(&db_handler,&errmsg,&sqlText);
-        sqlite3_shutdown();
-        return DATABASE_ERROR;
+    pthread_mutex_lock(&seen.lock);
+    if(DB_seenSlot(&pair)->address!=0){
+        seen.skipped++;
+        pthread_mutex_unlock(&seen.lock);
+        return 0;
     }
+    pthread_mutex_unlock(&seen.lock);
 
-    status=sqlite3_exec(db_handler,sqlText,NULL,NULL,&errmsg);
-    if(status==SQLITE_OK){
-        printf("Data was saved successfully into radarlivre_api_airline!\n");
-        LOG_add("DB_saveAirline","Data saved successfully");
-    } else {
-        printf("Data couldn't be saved: %s\n",errmsg?errmsg:"Unknown Err");
-        LOG_add("DB_saveAirline","Data couldn't be saved");
+    DB_aircraftRow(&row,DB_AIRLINE,msg);
+    status=DB_save(&row);
+    if(status!=0){
+        return status;
     }
 
-    DB_close(&db_handler,&errmsg,&sqlText);
-    sqlite3_shutdown();
-    return status;
+    pthread_mutex_lock(&seen.lock);
+    if(seen.count>=DB_SEEN_SIZE/4*3){
+        memset(seen.slots,0,sizeof(seen.slots));
+        seen.count=0;
+    }
+    slot=DB_seenSlot(&pair);
+    if(slot->address==0){
+        *slot=pair;
+        seen.count++;
+    }
+    pthread_mutex_unlock(&seen.lock);
+    return 0;
 }
 
 /*==============================================
@@ -179,16 +604,19 @@ FUNCTION: DB_saveData
 INPUT: pointer to adsbMsg
 OUTPUT: int status
 DESCRIPTION: calls DB_saveADSBInfo, DB_saveAirline,
-with up to 3 attempts each. returns 0 if success
+with up to 3 attempts each (one when they are queued
+for the writer, which doesn't make room by retrying).
+returns 0 if success
 ================================================*/
 int DB_saveData(adsbMsg *msg){
     int status1=-1, status2=-1;
-    int tries=3;
+    int attempts=writer.rows?1:3;
+    int tries=attempts;
     while(status1!=0 && tries>0){
         status1=DB_saveADSBInfo(msg);
         tries--;
     }
-    tries=3;
+    tries=attempts;
     while(status2!=0 && tries>0){
         status2=DB_saveAirline(msg);
         tries--;
@@ -205,40 +633,279 @@ OUTPUT: int status
 DESCRIPTION: saves system metrics into system_metrics
 ================================================*/
 int DB_saveSystemMetrics(double user_cpu, double sys_cpu, long max_rss) {
-    sqlite3 *db_handler = NULL;
-    char *sqlText = NULL, *errmsg = NULL;
-    int status = -1;
-    // Use a mesma constante DATABASE definida nos seus arquivos
-    sqlite3_initialize();
-    db_handler = DB_open(DATABASE);
-    if (!db_handler) {
-        sqlite3_shutdown();
+    dbRow row;
+
+    row.table = DB_METRICS;
+    row.now = getCurrentTime();
+    row.userCpu = user_cpu;
+    row.sysCpu = sys_cpu;
+    row.maxRss = max_rss;
+    return DB_save(&row);
+}
+
+/*==============================================
+FUNCTION: DB_commit
+INPUT: the rows of a batch and their number
+OUTPUT: void
+DESCRIPTION: inserts the rows in one transaction, so
+the batch costs one sync of the journal instead of
+one per row. A row that fails (e.g. its table is
+missing) is counted and the others are kept; if the
+commit fails the whole batch is lost.
+================================================*/
+static void DB_commit(const dbRow *batch,int n){
+    struct timespec start,end;
+    unsigned long failed=0;
+    double ms=0;
+    int i=0;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    if(DB_init(DATABASE)!=DATABASE_OK){
+        failed=n;
+    }else{
+        sqlite3_exec(context.db,"BEGIN;",NULL,NULL,NULL);
+        for(i=0;i<n;i++){
+            if(DB_insert(&batch[i])!=SQLITE_OK){
+                failed++;
+            }
+        }
+        if(sqlite3_exec(context.db,"COMMIT;",NULL,NULL,NULL)!=SQLITE_OK){
+            printf("Batch couldn't be committed: %s\n",sqlite3_errmsg(context.db));
+            LOG_add("DB_commit","batch couldn't be committed");
+            sqlite3_exec(context.db,"ROLLBACK;",NULL,NULL,NULL);
+            failed=n;
+        }else if(failed){
+            LOG_add("DB_commit","rows couldn't be saved");
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    ms=(end.tv_sec-start.tv_sec)*1e3+(end.tv_nsec-start.tv_nsec)/1e6;
+
+    pthread_mutex_lock(&writer.lock);
+    writer.stats.written+=n-failed;
+    writer.stats.failed+=failed;
+    writer.stats.commits++;
+    writer.stats.commitMs+=ms;
+    if(ms>writer.stats.maxCommitMs){
+        writer.stats.maxCommitMs=ms;
+    }
+    pthread_mutex_unlock(&writer.lock);
+}
+
+/*==============================================
+FUNCTION: DB_checkpoint
+INPUT: void
+OUTPUT: void
+DESCRIPTION: copies the WAL back into the database
+as far as the readers allow, without waiting for
+them (passive checkpoint). Once it is all copied the
+WAL is reused from its start, so it doesn't grow
+beyond what is written between two checkpoints.
+================================================*/
+static void DB_checkpoint(void){
+    int frames=0,copied=0;
+
+    if(sqlite3_wal_checkpoint_v2(context.db,NULL,SQLITE_CHECKPOINT_PASSIVE,&frames,&copied)!=SQLITE_OK){
+        LOG_add("DB_checkpoint","checkpoint failed");
+    }
+    pthread_mutex_lock(&writer.lock);
+    writer.stats.checkpoints++;
+    writer.stats.walFrames=frames;
+    writer.stats.walPending=frames-copied;
+    if((unsigned long)frames>writer.stats.maxWalFrames){
+        writer.stats.maxWalFrames=frames;
+    }
+    pthread_mutex_unlock(&writer.lock);
+}
+
+//An absolute CLOCK_REALTIME deadline, ms from now
+static void DB_deadline(struct timespec *deadline,long ms){
+    if(ms<0){
+        ms=0;
+    }
+    clock_gettime(CLOCK_REALTIME,deadline);
+    deadline->tv_sec+=ms/1000;
+    deadline->tv_nsec+=(ms%1000)*1000000L;
+    if(deadline->tv_nsec>=1000000000L){
+        deadline->tv_sec++;
+        deadline->tv_nsec-=1000000000L;
+    }
+}
+
+//ms on the monotonic clock, for the checkpoint cadence
+static double DB_ms(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return now.tv_sec*1e3+now.tv_nsec/1e6;
+}
+
+/*==============================================
+FUNCTION: DB_writerThread
+INPUT: unused
+OUTPUT: NULL
+DESCRIPTION: body of the writer thread. The first
+row queued opens a batch, which is committed when it
+has batchRows rows or is batchMs old, whichever comes
+first. In WAL mode, a checkpoint is made at most
+every checkpointMs after the commits, also when no
+more rows come. After DB_stopWriter() the queued
+rows are still written before the thread ends.
+================================================*/
+static void *DB_writerThread(void *arg){
+    struct timespec deadline;
+    double lastCheckpoint=DB_ms();
+    int dirty=0;        //commits since the last checkpoint
+    int checkpoints=context.wal&&(config.checkpointMs>0);
+    int n=0;
+    (void)arg;
+
+    pthread_mutex_lock(&writer.lock);
+    for(;;){
+        while((writer.count==0)&&writer.running){
+            if(!dirty){
+                pthread_cond_wait(&writer.filled,&writer.lock);
+                continue;
+            }
+            DB_deadline(&deadline,(long)(lastCheckpoint+config.checkpointMs-DB_ms())+1);
+            if(pthread_cond_timedwait(&writer.filled,&writer.lock,&deadline)==ETIMEDOUT){
+                break;
+            }
+        }
+        if((writer.count==0)&&!writer.running){
+            break;
+        }
+
+        if(writer.count>0){
+            DB_deadline(&deadline,writer.batchMs);
+            while((writer.count<writer.batchRows)&&writer.running){
+                if(pthread_cond_timedwait(&writer.filled,&writer.lock,&deadline)==ETIMEDOUT){
+                    break;
+                }
+            }
+            for(n=0;(n<writer.batchRows)&&(writer.count>0);n++){
+                writer.batch[n]=writer.rows[writer.tail];
+                writer.tail=(writer.tail+1)%writer.length;
+                writer.count--;
+            }
+        }else{
+            n=0;
+        }
+        pthread_mutex_unlock(&writer.lock);
+
+        if(n>0){
+            DB_commit(writer.batch,n);
+            dirty=checkpoints;
+        }
+        if(dirty&&(DB_ms()-lastCheckpoint>=config.checkpointMs)){
+            DB_checkpoint();
+            lastCheckpoint=DB_ms();
+            dirty=0;
+        }
+        pthread_mutex_lock(&writer.lock);
+    }
+    pthread_mutex_unlock(&writer.lock);
+    return NULL;
+}
+
+/*==============================================
+FUNCTION: DB_startWriter
+INPUT: the length of the queue, in rows, and the
+largest batch, in rows and in ms
+OUTPUT: DATABASE_OK or DATABASE_ERROR
+DESCRIPTION: allocates the queue and starts the
+writer thread. From then on the DB_save* functions
+only copy their row into the queue, and all the
+inserts and checkpoints are made by the writer.
+DB_init() must have been called.
+================================================*/
+int DB_startWriter(int length,int batchRows,int batchMs){
+    if((length<1)||(batchRows<1)||(batchMs<1)||writer.rows){
         return DATABASE_ERROR;
     }
-    // Obtenha um timestamp (pode usar getCurrentTime se retornar double)
-    long timestamp = (long)getCurrentTime();
-    
-    sqlText = sqlite3_mprintf(
-        "INSERT INTO system_metrics(timestamp, user_cpu, sys_cpu, max_rss) "
-        "VALUES(%ld, %lf, %lf, %ld);",
-        timestamp, user_cpu, sys_cpu, max_rss
-    );
-    if (!sqlText) {
-        printf("Query for system metrics couldn't be created!\n");
-        LOG_add("DB_saveSystemMetrics", "query couldn't be created");
-        DB_close(&db_handler, &errmsg, &sqlText);
-        sqlite3_shutdown();
+    if(batchRows>length){
+        batchRows=length;
+    }
+
+    memset(&writer,0,sizeof(writer));
+    writer.rows=(dbRow*)malloc(length*sizeof(dbRow));
+    writer.batch=(dbRow*)malloc(batchRows*sizeof(dbRow));
+    if(!writer.rows||!writer.batch){
+        free(writer.rows);
+        free(writer.batch);
+        writer.rows=NULL;
+        writer.batch=NULL;
+        LOG_add("DB_startWriter","writer queue couldn't be allocated");
         return DATABASE_ERROR;
     }
-    status = sqlite3_exec(db_handler, sqlText, NULL, NULL, &errmsg);
-    if (status == SQLITE_OK) {
-        printf("System metrics saved successfully!\n");
-        LOG_add("DB_saveSystemMetrics", "System metrics saved successfully");
-    } else {
-        printf("System metrics couldn't be saved: %s\n", errmsg ? errmsg : "Unknown Error");
-        LOG_add("DB_saveSystemMetrics", "System metrics couldn't be saved");
+    writer.length=length;
+    writer.batchRows=batchRows;
+    writer.batchMs=batchMs;
+
+    //The checkpoints are left to the writer, instead of the commit that fills the WAL
+    if(context.wal&&(config.checkpointMs>0)){
+        sqlite3_exec(context.db,"PRAGMA wal_autocheckpoint=0;",NULL,NULL,NULL);
     }
-    DB_close(&db_handler, &errmsg, &sqlText);
-    sqlite3_shutdown();
-    return status;
-}
\ No newline at end of file
+
+    pthread_mutex_init(&writer.lock,NULL);
+    pthread_cond_init(&writer.filled,NULL);
+    writer.running=1;
+    if(pthread_create(&writer.thread,NULL,DB_writerThread,NULL)!=0){
+        pthread_cond_destroy(&writer.filled);
+        pthread_mutex_destroy(&writer.lock);
+        free(writer.rows);
+        free(writer.batch);
+        writer.rows=NULL;
+        writer.batch=NULL;
+        writer.running=0;
+        LOG_add("DB_startWriter","writer thread couldn't be created");
+        return DATABASE_ERROR;
+    }
+    return DATABASE_OK;
+}
+
+/*==============================================
+FUNCTION: DB_stopWriter
+INPUT: void
+OUTPUT: void
+DESCRIPTION: waits for the writer to insert the
+rows still queued and frees the queue. The saves
+made afterwards are inserted at once again.
+================================================*/
+void DB_stopWriter(void){
+    dbRow *rows=writer.rows;
+
+    if(!rows){
+        return;
+    }
+    pthread_mutex_lock(&writer.lock);
+    writer.running=0;
+    pthread_cond_signal(&writer.filled);
+    pthread_mutex_unlock(&writer.lock);
+    pthread_join(writer.thread,NULL);
+
+    pthread_cond_destroy(&writer.filled);
+    pthread_mutex_destroy(&writer.lock);
+    writer.rows=NULL;
+    free(rows);
+    free(writer.batch);
+    writer.batch=NULL;
+}
+
+/*==============================================
+FUNCTION: DB_getStats
+INPUT: a pointer to dbStats
+OUTPUT: the counters of the writer, passed by reference
+================================================*/
+void DB_getStats(dbStats *out){
+    if(writer.rows){
+        pthread_mutex_lock(&writer.lock);
+        *out=writer.stats;
+        pthread_mutex_unlock(&writer.lock);
+    }else{
+        *out=writer.stats;
+    }
+    pthread_mutex_lock(&seen.lock);
+    out->airlineSkipped=seen.skipped;
+    pthread_mutex_unlock(&seen.lock);
+}
@@ -3,18 +3,106 @@
 
 /*===============================
 These functions are responsible
-for the database operations.
+for the database operations. The
+connection is opened once by
+DB_init() and each insert is a
+statement prepared on its first
+use, then only bound and stepped;
+DB_shutdown() closes them. After
+DB_startWriter() the saves only
+queue a copy of their row, which a
+writer thread inserts in batches,
+one transaction per batch. The
+journal is in WAL mode, so readers
+don't block the inserts, and the
+writer makes its checkpoints.
 =================================*/
 typedef struct sqlite3 sqlite3;
 typedef struct msg adsbMsg;
 
 #define DATABASE "radarlivre_v4.db"
 #define DATABASE_ERROR -1
+#define DATABASE_OK     0
+
+//Default values for the writer thread
+#define DB_DEFAULT_QUEUE       1024    // rows waiting to be inserted
+#define DB_DEFAULT_BATCH_ROWS  256     // rows committed at once, at most
+#define DB_DEFAULT_BATCH_MS    500     // ms a row waits for its batch, at most
+
+//Default values of the pragmas (see dbConfig)
+#define DB_DEFAULT_SYNCHRONOUS    "NORMAL"
+#define DB_DEFAULT_CACHE_KB       4096
+#define DB_DEFAULT_MMAP_MB        16
+#define DB_DEFAULT_BUSY_MS        5000
+#define DB_DEFAULT_CHECKPOINT_MS  10000
+#define DB_WAL_SIZE_LIMIT         (8 << 20)    // bytes the WAL is truncated to after a reset
+
+#define DB_SEEN_SIZE  8192    // slots of the icao/callsign pairs already saved (power of 2)
+
+/*==================================
+STRUCT: dbConfig
+DESCRIPTION:
+    const char *synchronous: OFF, NORMAL, FULL or EXTRA. With WAL,
+        NORMAL only syncs at the checkpoints: a power loss can
+        lose the last commits but not corrupt the database.
+    int cacheKb: page cache of the connection, in KiB.
+    int mmapMb: database read through a memory map, in MiB (0: off).
+    int busyMs: how long a statement waits for a lock before failing.
+    int checkpointMs: interval between the passive checkpoints of the
+        writer (0: let SQLite checkpoint at each 1000 pages).
+===================================*/
+typedef struct{
+    const char *synchronous;
+    int cacheKb;
+    int mmapMb;
+    int busyMs;
+    int checkpointMs;
+}dbConfig;
+
+/*==================================
+STRUCT: dbStats
+DESCRIPTION:
+    unsigned long queued: rows given to the writer.
+    unsigned long dropped: rows discarded because the queue was full.
+    unsigned long written, failed: rows inserted or not by the writer.
+    unsigned long commits: transactions (batches) of the writer.
+    unsigned long maxUsed: high-water mark of queued rows.
+    double commitMs, maxCommitMs: total and longest time to insert
+        and commit a batch, in ms.
+    unsigned long checkpoints: passive checkpoints of the writer.
+    unsigned long walFrames, walPending: pages in the WAL and not
+        yet copied to the database (held by a reader) at the last one.
+    unsigned long maxWalFrames: largest WAL seen by a checkpoint.
+    unsigned long airlineSkipped: icao/callsign pairs not saved
+        because they were already.
+===================================*/
+typedef struct{
+    unsigned long queued;
+    unsigned long dropped;
+    unsigned long written;
+    unsigned long failed;
+    unsigned long commits;
+    unsigned long maxUsed;
+    double commitMs;
+    double maxCommitMs;
+    unsigned long checkpoints;
+    unsigned long walFrames;
+    unsigned long walPending;
+    unsigned long maxWalFrames;
+    unsigned long airlineSkipped;
+}dbStats;
 
 sqlite3 * DB_open(char *db_name);
+int DB_configure(const dbConfig *config);
+int DB_init(char *db_name);
+void DB_shutdown(void);
 int DB_saveADSBInfo(adsbMsg *msg);
 int DB_saveAirline(adsbMsg *msg);
 int DB_saveData(adsbMsg *msg);
+int DB_saveSystemMetrics(double user_cpu, double sys_cpu, long max_rss);
+int DB_startWriter(int length, int batchRows, int batchMs);
+void DB_stopWriter(void);
+void DB_getStats(dbStats *stats);
 void DB_close(sqlite3 **db_handler, char**errmsg, char**sqlText);
 
-#endif
\ No newline at end of file
+#endif
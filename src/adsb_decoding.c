@@ -5,20 +5,38 @@
 #include "adsb_decoding.h"
 #include "adsb_auxiliars.h"
 #include "adsb_lists.h"
+#include "adsb_aircraft.h"
 #include "adsb_time.h"
 #include "adsb_createLog.h"
+#include "adsb_crc.h"
+#include "adsb_commb.h"
+
+//Reference of the local CPR decoding, set with setReceiverPosition()
+static int receiverSet = 0;
+static double receiverLat = 0, receiverLon = 0;
+static positionStats posStats;
+static decodeStats decStats;
+
+//Altitude of each 12-bit altitude code (Q bit included), built by DECODING_init()
+static int altitudeTable[4096];
+//Ground speed in knots of each 7-bit surface movement code, or -1
+static float movementTable[128];
+//atan(i / 2^ATAN_TABLE_BITS) in hundredths of a degree (0 to 4500)
+static int atanTable[(1 << ATAN_TABLE_BITS) + 1];
+//sqrt(1 + (i / 2^ATAN_TABLE_BITS)^2) in Q16 (65536 to 92682)
+static unsigned hypotTable[(1 << ATAN_TABLE_BITS) + 1];
 
 /*==============================================
 FUNCTION: isPositionMessage
-INPUT: 28-char hex message
+INPUT: a frame
 OUTPUT: 1 if typecode indicates position (5..18),
         0 otherwise
 DESCRIPTION: Checks if the type code is in the
 range for an airborne position message.
 ================================================*/
-int isPositionMessage(char *msgi)
+int isPositionMessage(const adsbFrame *frame)
 {
-    int tc = getTypecode(msgi);
+    int tc = FRAME_tc(frame);
     // Typecode 5..18 => airborne position
     if (tc < 5 || tc > 18) {
         return 0;
@@ -26,55 +44,73 @@ int isPositionMessage(char *msgi)
     return 1;
 }
 
+/*==============================================
+FUNCTION: isSurfaceMessage
+INPUT: a frame
+OUTPUT: 1 if typecode indicates a surface
+position (5..8), 0 otherwise
+================================================*/
+int isSurfaceMessage(const adsbFrame *frame)
+{
+    int tc = FRAME_tc(frame);
+    return (tc >= 5) && (tc <= 8);
+}
+
 /*==============================================
 FUNCTION: getPositionType
-INPUT: 28-char hex message
+INPUT: a frame
 OUTPUT: 0 for even, 1 for odd, or DECODING_ERROR
 DESCRIPTION: Returns the "CPR odd/even" bit (bit 53)
 from an airborne position message. If it's not
 a position message, returns DECODING_ERROR.
 ================================================*/
-int getPositionType(char *msgi)
+int getPositionType(const adsbFrame *frame)
 {
-    if (!isPositionMessage(msgi)) {
+    if (!isPositionMessage(frame)) {
         return DECODING_ERROR;
     }
-    char msgbin[113];
-    hex2bin(msgi, msgbin);
-    msgbin[112] = '\0';
+    return FRAME_getBit(frame, 53);
+}
+
+/*==============================================
+FUNCTION: getCPRLatitude
+INPUT: a frame
+OUTPUT: the 17-bit CPR latitude (bits 54..70)
+================================================*/
+int getCPRLatitude(const adsbFrame *frame)
+{
+    return (int)FRAME_getBits(frame, 54, 17);
+}
 
-    // bit 53 => '0' or '1'
-    // convert from char '0'/'1' to int 0/1
-    return msgbin[53] - '0';
+/*==============================================
+FUNCTION: getCPRLongitude
+INPUT: a frame
+OUTPUT: the 17-bit CPR longitude (bits 71..87)
+================================================*/
+int getCPRLongitude(const adsbFrame *frame)
+{
+    return (int)FRAME_getBits(frame, 71, 17);
 }
 
 /*==============================================
 FUNCTION: getCallsign
-INPUT: two char pointers
+INPUT: a frame and a char pointer
 OUTPUT: an integer (status)
 DESCRIPTION: Decodes the callsign from a typecode=1..4
 ADS-B message. Fills 'msgf' with the callsign string.
 ================================================*/
-int getCallsign(char *msgi, char *msgf) {
-    if ((getTypecode(msgi) < 1) || (getTypecode(msgi) > 4)) {
+int getCallsign(const adsbFrame *frame, char *msgf) {
+    int tc = FRAME_tc(frame);
+    if ((tc < 1) || (tc > 4)) {
         return DECODING_ERROR;
     }
 
-    char cs_table[] = "#ABCDEFGHIJKLMNOPQRSTUVWXYZ#####_###############0123456789######";
-    char msgbin[113], char_aux[7];
+    static const char cs_table[] = "#ABCDEFGHIJKLMNOPQRSTUVWXYZ#####_###############0123456789######";
     int i = 0, pos = 0, j = 0;
 
-    hex2bin(msgi, msgbin);
-    msgbin[112] = '\0';
-
-    // Extract bits [40..87], total 48 bits for callsign
-    strncpy(msgbin, &msgbin[40], 48);
-    msgbin[48] = '\0';
-
-    for (j = 0; j * 6 < 48; j++) {
-        strncpy(char_aux, &msgbin[j * 6], 6);
-        char_aux[6] = '\0';
-        pos = bin2int(char_aux);
+    // Bits [40..87], 8 characters of 6 bits
+    for (j = 0; j < 8; j++) {
+        pos = FRAME_getBits(frame, 40 + j * 6, 6);
         if (cs_table[pos] == '#') {
             continue;
         }
@@ -90,86 +126,138 @@ int getCallsign(char *msgi, char *msgf) {
     return DECODING_OK;
 }
 
+/*==============================================
+FUNCTION: vectorToPolar
+INPUT: the east and north velocity components and
+a pointer to the speed
+OUTPUT: the track in hundredths of a degree,
+clockwise from the north (0 to 35999), and the
+speed in knots, rounded, passed by reference
+DESCRIPTION: integer atan2 and hypot. The smaller
+component over the larger one gives a ratio in
+[0, 1]; its arctangent (0 to 45 degrees) and
+sqrt(1 + ratio^2) are interpolated in atanTable and
+hypotTable, and the octant then gives the track.
+The speed is then checked against the exact sum of
+squares, so it is rounded like sqrt() would.
+================================================*/
+static int vectorToPolar(int ew, int ns, unsigned *speed){
+    unsigned a = (ew < 0) ? -ew : ew, b = (ns < 0) ? -ns : ns;
+    unsigned lo = (a < b) ? a : b, hi = (a < b) ? b : a;
+    unsigned ratio = 0, index = 0, frac = 0, hyp = 0, sq = 0;
+    int base = 0;
+
+    if(hi == 0){
+        *speed = 0;
+        return 0;
+    }
+    ratio = (lo << 16) / hi;                    // Q16, 0 to 65536
+    index = ratio >> (16 - ATAN_TABLE_BITS);
+    frac = ratio & ((1u << (16 - ATAN_TABLE_BITS)) - 1);
+    if(index == (1u << ATAN_TABLE_BITS)){
+        index--;                                // lo == hi: last interval, frac 1
+        frac = 1u << (16 - ATAN_TABLE_BITS);
+    }
+    base = atanTable[index] +
+           (int)(((atanTable[index + 1] - atanTable[index]) * (int)frac) >> (16 - ATAN_TABLE_BITS));
+    hyp = hypotTable[index] +
+          (((hypotTable[index + 1] - hypotTable[index]) * frac) >> (16 - ATAN_TABLE_BITS));
+    *speed = (hi * hyp + (1u << 15)) >> 16;
+    // the interpolation can be 1 kt off next to x.5: round on the exact square
+    sq = 4 * (a*a + b*b);
+    if(sq < 4 * *speed * *speed - 4 * *speed + 1){
+        (*speed)--;
+    }else if(sq >= 4 * *speed * *speed + 4 * *speed + 1){
+        (*speed)++;
+    }
+    if(a > b){
+        base = 9000 - base;                     // angle from the north, not from the east
+    }
+
+    if(ns >= 0){
+        return (ew >= 0) ? base : (36000 - base) % 36000;
+    }
+    return (ew >= 0) ? 18000 - base : 18000 + base;
+}
+
 /*==============================================
 FUNCTION: getVelocities
 INPUT: 
-  - msgi: the 28-char hex message
-  - node: pointer to the adsbMsg struct to store NACv
+  - frame: the ADS-B frame
+  - cold: the cold part of the aircraft, to store NACv
   - speed, head: float pointers
   - rateCD: pointer to int
-  - tag: pointer to char (e.g. "GS" or "AS")
+  - tag: pointer to char[4] ("GS", "IAS" or "TAS")
 OUTPUT: 0 if success, DECODING_ERROR if not typecode=19
+or if the speed is not available
 DESCRIPTION: Decodes horizontal/vertical velocity from a
-typecode=19 ADS-B message. Also sets NACv in node->NACv.
+typecode=19 ADS-B message. Also sets NACv in cold->NACv.
+Subtypes 1/2 give the east and north ground speed,
+3/4 the heading and the airspeed; 2 and 4 are the
+supersonic ones, in 4 kt units. Speed and track are
+computed in integer arithmetic (vectorToPolar),
+to the 1 kt / 0.01 degree resolution.
+The heading and the vertical rate are only written
+when available.
 ================================================*/
-int getVelocities(char *msgi, adsbMsg *node, float *speed, float *head, int *rateCD, char *tag) {
-    if (getTypecode(msgi) != 19) {
+int getVelocities(const adsbFrame *frame, adsbCold *cold, float *speed, float *head, int *rateCD, char *tag) {
+    if (FRAME_tc(frame) != 19) {
         return DECODING_ERROR;
     }
 
-    char msgbin[113], msgAUX[113];
-    int subtype = 0;
-    int Vew_sign = 0, Vns_sign = 0;
+    int subtype = 0, unit = 1;
     int Vel_ew = 0, Vel_ns = 0;
-    int Vr_sign = 0, Vr = 0;
-
-    hex2bin(msgi, msgbin);
-    msgbin[112] = '\0';
+    int Vr = 0;
 
     // bits [37..39] => subtype
-    strncpy(msgAUX, &msgbin[37], 3);
-    msgAUX[3] = '\0';
-    subtype = bin2int(msgAUX);
-
-    // NACv is bits [43..45] 
-    {
-        char nacvBits[4];
-        strncpy(nacvBits, &msgbin[43], 3);
-        nacvBits[3] = '\0';
-        int NACv_val = bin2int(nacvBits);
-        node->NACv = NACv_val;
+    subtype = FRAME_getBits(frame, 37, 3);
+    if (subtype < 1 || subtype > 4) {
+        return DECODING_ERROR;
+    }
+    if (subtype == 2 || subtype == 4) {
+        unit = 4;
     }
 
+    // NACv is bits [42..44] 
+    cold->NACv = FRAME_getBits(frame, NACV_BIT_START, NACV_BIT_LEN);
+
     if (subtype == 1 || subtype == 2) {
-        // ground speed logic
-        Vew_sign = msgbin[45] - '0';
-        strncpy(msgAUX, &msgbin[46], 10);
-        msgAUX[10] = '\0';
-        Vel_ew = bin2int(msgAUX) - 1;
-
-        Vns_sign = msgbin[56] - '0';
-        strncpy(msgAUX, &msgbin[57], 10);
-        msgAUX[10] = '\0';
-        Vel_ns = bin2int(msgAUX) - 1;
-
-        if (Vew_sign) Vel_ew = -Vel_ew;
-        if (Vns_sign) Vel_ns = -Vel_ns;
-
-        *speed = sqrtf((float)(Vel_ew*Vel_ew + Vel_ns*Vel_ns));
-        *head  = atan2f((float)Vel_ew, (float)Vel_ns)*180.0f/PI_MATH;
-        if (*head < 0) *head += 360;
+        // ground speed logic: 0 means not available
+        Vel_ew = (int)FRAME_getBits(frame, 46, 10);
+        Vel_ns = (int)FRAME_getBits(frame, 57, 10);
+        if (Vel_ew == 0 || Vel_ns == 0) {
+            return DECODING_ERROR;
+        }
+        Vel_ew = (Vel_ew - 1) * unit;
+        Vel_ns = (Vel_ns - 1) * unit;
+
+        if (FRAME_getBit(frame, 45)) Vel_ew = -Vel_ew;
+        if (FRAME_getBit(frame, 56)) Vel_ns = -Vel_ns;
+
+        unsigned gs = 0;
+
+        *head  = vectorToPolar(Vel_ew, Vel_ns, &gs) / 100.0f;
+        *speed = (float)gs;
         strcpy(tag, "GS");
     } else {
         // airspeed logic (subtype 3 or 4)
-        strncpy(msgAUX, &msgbin[46], 10);
-        msgAUX[10] = '\0';
-        *head = (bin2int(msgAUX)/1024.0f)*360.0f;
-
-        strncpy(msgAUX, &msgbin[57], 10);
-        msgAUX[10] = '\0';
-        *speed = bin2int(msgAUX);
-
-        strcpy(tag, "AS");
+        int airspeed = (int)FRAME_getBits(frame, 57, 10);
+        if (airspeed == 0) {
+            return DECODING_ERROR;
+        }
+        if (FRAME_getBit(frame, 45)) {
+            *head = (int)(FRAME_getBits(frame, 46, 10) * 36000 / 1024) / 100.0f;
+        }
+        *speed = (float)((airspeed - 1) * unit);
+        strcpy(tag, FRAME_getBit(frame, 56) ? "TAS" : "IAS");
     }
 
-    Vr_sign = msgbin[68] - '0';
-    strncpy(msgAUX, &msgbin[69], 9);
-    msgAUX[9] = '\0';
-    Vr = bin2int(msgAUX);
-
-    *rateCD = (Vr - 1)*64;
-    if (Vr_sign) {
-        *rateCD = -*rateCD; // down
+    Vr = FRAME_getBits(frame, 69, 9);
+    if (Vr != 0) {
+        *rateCD = (Vr - 1)*64;
+        if (FRAME_getBit(frame, 68)) {
+            *rateCD = -*rateCD; // down
+        }
     }
 
     return 0;
@@ -178,147 +266,606 @@ int getVelocities(char *msgi, adsbMsg *node, float *speed, float *head, int *rat
 /*==============================================
 FUNCTION: parseOperationalStatus
 INPUT: 
-  - hexMessage: 28-char hex
-  - node: pointer to adsbMsg
+  - frame: the ADS-B frame
+  - cold: the cold part of the aircraft
 OUTPUT: int status
 DESCRIPTION: for typecode=31 (operational status),
 extract NACp, NACv, NIC, SIL, SDA from certain bits.
 ================================================*/
-int parseOperationalStatus(const char *hexMessage, adsbMsg *node) {
+int parseOperationalStatus(const adsbFrame *frame, adsbCold *cold) {
     // Input validation
-    if (strlen(hexMessage) != 28 || node == NULL) {
+    if (frame == NULL || cold == NULL) {
         return DECODING_ERROR; // Invalid input
     }
 
-    // Convert hex to binary
-    char binMsg[113]; // 112 bits + null terminator
-    hex2bin((char *)hexMessage, binMsg);
-    binMsg[112] = '\0'; // Ensure null-termination
-
-    // Extract NACp (bits 56-59)
-    char nacpBits[5]; // 4 bits + null terminator
-    strncpy(nacpBits, &binMsg[56], 4);
-    nacpBits[4] = '\0'; // Null-terminate
-    node->NACp = bin2int(nacpBits);
-
-    // Extract NACv (bits 60-62)
-    char nacvBits[4]; // 3 bits + null terminator
-    strncpy(nacvBits, &binMsg[60], 3);
-    nacvBits[3] = '\0'; // Null-terminate
-    node->NACv = bin2int(nacvBits);
-
-    // Extract NIC (bits 50-53)
-    char nicBits[5]; // 4 bits + null terminator
-    strncpy(nicBits, &binMsg[50], 4);
-    nicBits[4] = '\0'; // Null-terminate
-    node->NIC = bin2int(nicBits);
-
-    // Extract SIL (bits 47-48)
-    char silBits[3]; // 2 bits + null terminator
-    strncpy(silBits, &binMsg[47], 2);
-    silBits[2] = '\0'; // Null-terminate
-    node->SIL = bin2int(silBits);
-
-    // Extract SDA (bits 63-64)
-    char sdaBits[3]; // 2 bits + null terminator
-    strncpy(sdaBits, &binMsg[63], 2);
-    sdaBits[2] = '\0'; // Null-terminate
-    node->SDA = bin2int(sdaBits);
+    cold->NACp = FRAME_getBits(frame, 56, 4);   // bits 56-59
+    cold->NACv = FRAME_getBits(frame, 60, 3);   // bits 60-62
+    cold->NIC  = FRAME_getBits(frame, 50, 4);   // bits 50-53
+    cold->SIL  = FRAME_getBits(frame, 47, 2);   // bits 47-48
+    cold->SDA  = FRAME_getBits(frame, 63, 2);   // bits 63-64
 
     // Validate extracted values
-    if (node->NACp < 0 || node->NACp > 15) {
+    if (cold->NACp < 0 || cold->NACp > 15) {
         LOG_add("parseOperationalStatus", "Invalid NACp value");
         return DECODING_ERROR;
     }
-    if (node->NACv < 0 || node->NACv > 7) {
+    if (cold->NACv < 0 || cold->NACv > 7) {
         LOG_add("parseOperationalStatus", "Invalid NACv value");
         return DECODING_ERROR;
     }
-    if (node->NIC < 0 || node->NIC > 15) {
+    if (cold->NIC < 0 || cold->NIC > 15) {
         LOG_add("parseOperationalStatus", "Invalid NIC value");
         return DECODING_ERROR;
     }
-    if (node->SIL < 0 || node->SIL > 3) {
+    if (cold->SIL < 0 || cold->SIL > 3) {
         LOG_add("parseOperationalStatus", "Invalid SIL value");
         return DECODING_ERROR;
     }
-    if (node->SDA < 0 || node->SDA > 3) {
+    if (cold->SDA < 0 || cold->SDA > 3) {
         LOG_add("parseOperationalStatus", "Invalid SDA value");
         return DECODING_ERROR;
     }
 
     // Debug output
     printf("[parseOperationalStatus] NACp=%d NACv=%d NIC=%d SIL=%d SDA=%d\n",
-           node->NACp, node->NACv, node->NIC, node->SIL, node->SDA);
+           cold->NACp, cold->NACv, cold->NIC, cold->SIL, cold->SDA);
 
     return DECODING_OK;
 }
 
+/*==============================================
+FUNCTION: getNL
+INPUT: a latitude in degrees
+OUTPUT: the number of longitude zones (1 to 59)
+DESCRIPTION: NL() of the CPR. transitionLatTable is
+sorted downwards, so NL - 1 is the number of its
+entries above |lat|. They are counted with a binary
+search whose steps only select (no branch to
+mispredict), instead of the acos/cos formula.
+================================================*/
+int getNL(double lat){
+    const float *base = transitionLatTable;
+    int len = sizeof(transitionLatTable) / sizeof(transitionLatTable[0]);
+    float alat = (float)fabs(lat);
+
+    while(len > 1){
+        int half = len / 2;
+        base += (base[half - 1] > alat) * half;
+        len -= half;
+    }
+    return (int)(base - transitionLatTable) + (*base > alat) + 1;
+}
+
+//Positive remainder, as the CPR equations need
+static int cprMod(int a, int b){
+    int r = a % b;
+    return (r < 0) ? r + b : r;
+}
+
 /*==============================================
 FUNCTION: getAirbornePosition
-INPUT: two hex messages (EVEN, ODD), timestamps, pointers to lat/lon
+INPUT: the CPR latitude/longitude of the EVEN and
+ODD messages, their timestamps, pointers to lat/lon
 OUTPUT: DECODING_OK or DECODING_ERROR
-DESCRIPTION: computes lat/lon from CPR even+odd frames.
+DESCRIPTION: computes lat/lon from CPR even+odd
+frames (global decoding). The pair must be at most
+10 s apart, the same window used by setPosition.
+The position is the one of the most recent frame.
+If the two frames are in different latitude zones
+the aircraft crossed a zone boundary between them
+and the pair is refused.
 ================================================*/
-int getAirbornePosition(char *msgEVEN, char *msgODD, double timeE, double timeO, float *lat, float *lon){
-    // (CPR decode code you'd had previously)
-    return DECODING_OK; // stub
+int getAirbornePosition(const int cprEVEN[2], const int cprODD[2], double timeE, double timeO, float *lat, float *lon){
+    const double dlatE = 360.0 / 60, dlatO = 360.0 / 59;
+    double rlatE = 0, rlatO = 0, rlon = 0;
+    int j = 0, m = 0, nl = 0, ni = 0;
+    int odd = (timeO > timeE);
+
+    if(fabs(timeE - timeO) > 10){
+        return DECODING_ERROR;
+    }
+
+    // Latitude index and the latitude of each frame
+    j = (int)floor((59.0 * cprEVEN[0] - 60.0 * cprODD[0]) / CPR_SCALE + 0.5);
+    rlatE = dlatE * (cprMod(j, 60) + cprEVEN[0] / (double)CPR_SCALE);
+    rlatO = dlatO * (cprMod(j, 59) + cprODD[0] / (double)CPR_SCALE);
+    if(rlatE >= 270) rlatE -= 360;
+    if(rlatO >= 270) rlatO -= 360;
+    if((rlatE < -90) || (rlatE > 90) || (rlatO < -90) || (rlatO > 90)){
+        return DECODING_ERROR;
+    }
+
+    nl = getNL(rlatE);
+    if(nl != getNL(rlatO)){
+        return DECODING_ERROR;
+    }
+
+    // Longitude index, with the zones of the most recent frame
+    ni = odd ? nl - 1 : nl;
+    if(ni < 1) ni = 1;
+    m = (int)floor((cprEVEN[1] * (double)(nl - 1) - cprODD[1] * (double)nl) / CPR_SCALE + 0.5);
+    rlon = (360.0 / ni) * (cprMod(m, ni) + (odd ? cprODD[1] : cprEVEN[1]) / (double)CPR_SCALE);
+    if(rlon >= 180) rlon -= 360;
+
+    *lat = (float)(odd ? rlatO : rlatE);
+    *lon = (float)rlon;
+    return DECODING_OK;
 }
 
 /*==============================================
-FUNCTION: getAltitude
-INPUT: 28-char hex
+FUNCTION: getLocalPosition
+INPUT: the CPR latitude/longitude of one frame, its
+type (0 even, 1 odd), 1 for a surface frame, a
+reference position, the largest accepted distance
+to it in NM, pointers to lat/lon
+OUTPUT: DECODING_OK or DECODING_ERROR
+DESCRIPTION: computes lat/lon from a single frame
+(local decoding), choosing the zones closest to the
+reference. It is only unambiguous if the aircraft is
+within half a zone (about 180 NM, 45 NM for the
+surface frames, whose zones are 4 times smaller) of
+the reference, so positions further than maxRange
+are refused.
+================================================*/
+int getLocalPosition(int cprLat, int cprLon, int odd, int surface, double refLat, double refLon, double maxRange, float *lat, float *lon){
+    double span = surface ? 90.0 : 360.0;
+    double dlat = span / (60 - odd);
+    double dlon = 0, rlat = 0, rlon = 0, dx = 0, dy = 0;
+    int j = 0, m = 0, ni = 0;
+
+    j = (int)floor(refLat / dlat) +
+        (int)floor(0.5 + fmod(refLat + 360, dlat) / dlat - cprLat / (double)CPR_SCALE);
+    rlat = dlat * (j + cprLat / (double)CPR_SCALE);
+    if((rlat < -90) || (rlat > 90)){
+        return DECODING_ERROR;
+    }
+
+    ni = getNL(rlat) - odd;
+    if(ni < 1) ni = 1;
+    dlon = span / ni;
+    m = (int)floor(refLon / dlon) +
+        (int)floor(0.5 + fmod(refLon + 360, dlon) / dlon - cprLon / (double)CPR_SCALE);
+    rlon = dlon * (m + cprLon / (double)CPR_SCALE);
+    if(rlon >= 180) rlon -= 360;
+    if(rlon < -180) rlon += 360;
+
+    // Flat-earth distance in NM, enough at these ranges
+    dy = (rlat - refLat) * 60;
+    dx = remainder(rlon - refLon, 360) * 60 * cos(refLat * PI_MATH / 180);
+    if((dx * dx + dy * dy) > (maxRange * maxRange)){
+        return DECODING_ERROR;
+    }
+
+    *lat = (float)rlat;
+    *lon = (float)rlon;
+    return DECODING_OK;
+}
+
+/*==============================================
+FUNCTION: setReceiverPosition
+INPUT: the receiver latitude and longitude
+OUTPUT: void
+DESCRIPTION: enables the local decoding of the
+first positions of an aircraft against the
+receiver, before an even/odd pair is received.
+================================================*/
+void setReceiverPosition(double lat, double lon){
+    receiverLat = lat;
+    receiverLon = lon;
+    receiverSet = 1;
+}
+
+/*==============================================
+FUNCTION: getPositionStats
+INPUT: a pointer to positionStats
+OUTPUT: the counters, passed by reference
+================================================*/
+void getPositionStats(positionStats *stats){
+    *stats = posStats;
+}
+
+/*==============================================
+FUNCTION: decodePosition
+INPUT: an airborne position frame, its node
+OUTPUT: DECODING_OK or DECODING_ERROR
+DESCRIPTION: once the aircraft has a recent fix,
+each frame is decoded alone against it, so every
+frame gives a position. Otherwise the even/odd pair
+is decoded (global) or, if there is no pair yet,
+the frame is decoded against the receiver.
+================================================*/
+static int decodePosition(const adsbFrame *frame, adsbMsg *node, float *lat, float *lon){
+    int odd = getPositionType(frame);
+    int cprLat = getCPRLatitude(frame), cprLon = getCPRLongitude(frame);
+
+    if((node->frames & MSG_FIX) && (TIME_elapsed(node->fixTimestamp, node->oeTimestamp[odd]) <= CPR_FIX_MAX_AGE)){
+        if(getLocalPosition(cprLat, cprLon, odd, 0, node->Latitude, node->Longitude,
+                            CPR_FIX_MAX_RANGE_NM, lat, lon) == DECODING_OK){
+            posStats.local_fix++;
+            return DECODING_OK;
+        }
+    }
+    if((node->frames & (MSG_EVEN | MSG_ODD)) == (MSG_EVEN | MSG_ODD)){
+        // the times are only compared: the odd one is given relative to the even one
+        double timeO = (int32_t)(node->oeTimestamp[1] - node->oeTimestamp[0]) / 1000.0;
+
+        if(getAirbornePosition(node->oeCPR[0], node->oeCPR[1], 0, timeO, lat, lon) == DECODING_OK){
+            posStats.global++;
+            return DECODING_OK;
+        }
+    }else if(receiverSet){
+        if(getLocalPosition(cprLat, cprLon, odd, 0, receiverLat, receiverLon,
+                            CPR_RECEIVER_MAX_RANGE_NM, lat, lon) == DECODING_OK){
+            posStats.local_receiver++;
+            return DECODING_OK;
+        }
+    }
+    posStats.undecoded++;
+    return DECODING_ERROR;
+}
+
+/*==============================================
+FUNCTION: decodeSurfacePosition
+INPUT: a surface position frame, its node
+OUTPUT: DECODING_OK or DECODING_ERROR
+DESCRIPTION: surface frames are always decoded
+alone, against the last fix of the aircraft or
+the receiver: an even/odd pair only gives the
+position modulo 90 degrees.
+================================================*/
+static int decodeSurfacePosition(const adsbFrame *frame, adsbMsg *node, uint32_t now, float *lat, float *lon){
+    int odd = getPositionType(frame);
+    int cprLat = getCPRLatitude(frame), cprLon = getCPRLongitude(frame);
+
+    if((node->frames & MSG_FIX) && (TIME_elapsed(node->fixTimestamp, now) <= CPR_FIX_MAX_AGE)){
+        if(getLocalPosition(cprLat, cprLon, odd, 1, node->Latitude, node->Longitude,
+                            CPR_FIX_MAX_RANGE_NM, lat, lon) == DECODING_OK){
+            posStats.surface++;
+            return DECODING_OK;
+        }
+    }
+    if(receiverSet){
+        if(getLocalPosition(cprLat, cprLon, odd, 1, receiverLat, receiverLon,
+                            CPR_SURFACE_MAX_RANGE_NM, lat, lon) == DECODING_OK){
+            posStats.surface++;
+            return DECODING_OK;
+        }
+    }
+    posStats.undecoded++;
+    return DECODING_ERROR;
+}
+
+/*==============================================
+FUNCTION: getSurfaceMovement
+INPUT: a surface position frame, pointers to the
+ground speed (knots) and the ground track (degrees)
+OUTPUT: DECODING_OK, or DECODING_ERROR if the speed
+is not available. The track is only written if its
+status bit (44) is set.
+================================================*/
+int getSurfaceMovement(const adsbFrame *frame, float *speed, float *track){
+    float movement = 0;
+
+    if(!isSurfaceMessage(frame)){
+        return DECODING_ERROR;
+    }
+    movement = movementTable[FRAME_getBits(frame, 37, 7)];
+    if(movement < 0){
+        return DECODING_ERROR;
+    }
+    *speed = movement;
+    if(FRAME_getBit(frame, 44)){
+        *track = FRAME_getBits(frame, 45, 7) * 360.0f / 128;
+    }
+    return DECODING_OK;
+}
+
+/*==============================================
+FUNCTION: gillhamAltitude
+INPUT: a 12-bit altitude code with the Q bit clear,
+in the order C1 A1 C2 A2 C4 A4 B1 Q B2 D2 B4 D4
 OUTPUT: altitude in feet or DECODING_ERROR
-DESCRIPTION: returns altitude from Q-bit / Gillham-coded field
+DESCRIPTION: Mode C (Gillham) code, in 100 ft steps.
+D2..B4 are the 500 ft steps in Gray code; C1 C2 C4
+the 100 ft steps within them, in a 5-state cycle
+that runs backwards on odd 500 ft steps. D1 is not
+transmitted (it would be above 126700 ft).
 ================================================*/
-int getAltitude(char *msgi){ 
-    // calls isPositionMessage:
-    if(!isPositionMessage(msgi)){
+static int gillhamAltitude(int code){
+    int hundreds = 0, fiveHundreds = 0;
+
+    if(code & 0x800) hundreds ^= 7;         // C1
+    if(code & 0x200) hundreds ^= 3;         // C2
+    if(code & 0x080) hundreds ^= 1;         // C4
+    if((hundreds & 5) == 5) hundreds ^= 2;  // 7 <-> 5
+    if((hundreds < 1) || (hundreds > 5)){
         return DECODING_ERROR;
     }
 
-    char msgbin[113], msgAUX[12];
-    hex2bin(msgi,msgbin);
-    msgbin[112] = '\0';
+    // Gray to binary: each bit flips itself and the bits below it
+    if(code & 0x004) fiveHundreds ^= 0xFF;  // D2
+    if(code & 0x001) fiveHundreds ^= 0x7F;  // D4
+    if(code & 0x400) fiveHundreds ^= 0x3F;  // A1
+    if(code & 0x100) fiveHundreds ^= 0x1F;  // A2
+    if(code & 0x040) fiveHundreds ^= 0x0F;  // A4
+    if(code & 0x020) fiveHundreds ^= 0x07;  // B1
+    if(code & 0x008) fiveHundreds ^= 0x03;  // B2
+    if(code & 0x002) fiveHundreds ^= 0x01;  // B4
 
-    char Qbit = msgbin[47];
-    if(Qbit == '1'){
-        strncpy(msgAUX, &msgbin[40], 7);
-        msgAUX[7] = '\0';
-        strncat(msgAUX, &msgbin[48], 4);
-        msgAUX[11] = '\0';
+    if(fiveHundreds & 1){
+        hundreds = 6 - hundreds;
+    }
+    return (fiveHundreds * 5 + hundreds - 13) * 100;
+}
+
+/*==============================================
+FUNCTION: DECODING_init
+INPUT: void
+OUTPUT: void
+DESCRIPTION: builds the altitude and the surface
+movement tables, so both fields are decoded with
+one lookup, and the arctangent table of the track.
+Must be called before decodeMessage().
+================================================*/
+void DECODING_init(void){
+    int code = 0;
+
+    for(code = 0; code < 4096; code++){
+        if(code & 0x010){
+            // Q bit set: 25 ft steps, the 11 bits around it
+            int N = ((code & 0xFE0) >> 1) | (code & 0x00F);
+            altitudeTable[code] = N*25 - 1000;
+        }else{
+            altitudeTable[code] = gillhamAltitude(code);
+        }
+    }
+
+    for(code = 0; code <= (1 << ATAN_TABLE_BITS); code++){
+        double ratio = (double)code / (1 << ATAN_TABLE_BITS);
 
-        int N = bin2int(msgAUX);
-        return N*25 - 1000;
+        atanTable[code] = (int)(atan(ratio) * 18000.0 / PI_MATH + 0.5);
+        hypotTable[code] = (unsigned)(sqrt(1 + ratio*ratio) * 65536.0 + 0.5);
+    }
+
+    movementTable[0] = -1;                  // not available
+    for(code = 1; code < 128; code++){
+        if(code == 1)        movementTable[code] = 0;   // stopped
+        else if(code <= 8)   movementTable[code] = 0.125f + (code - 2) * 0.125f;
+        else if(code <= 12)  movementTable[code] = 1 + (code - 9) * 0.25f;
+        else if(code <= 38)  movementTable[code] = 2 + (code - 13) * 0.5f;
+        else if(code <= 93)  movementTable[code] = 15 + (code - 39);
+        else if(code <= 108) movementTable[code] = 70 + (code - 94) * 2;
+        else if(code <= 123) movementTable[code] = 100 + (code - 109) * 5;
+        else if(code == 124) movementTable[code] = 175;  // 175 kt or more
+        else                 movementTable[code] = -1;  // reserved
+    }
+}
+
+/*==============================================
+FUNCTION: getAltitudeCode
+INPUT: a 12-bit altitude code (Q bit included)
+OUTPUT: altitude in feet or DECODING_ERROR
+================================================*/
+int getAltitudeCode(int code){
+    return altitudeTable[code & 0xFFF];
+}
+
+/*==============================================
+FUNCTION: getReplyAltitude
+INPUT: a DF0/4/16/20 frame
+OUTPUT: altitude in feet or DECODING_ERROR
+DESCRIPTION: the 13-bit altitude code of the
+surveillance replies (bits 19..31) is the 12-bit
+one with the M bit (25) inserted. Metric altitudes
+(M set) are not decoded.
+================================================*/
+int getReplyAltitude(const adsbFrame *frame){
+    int ac = FRAME_getBits(frame, 19, 13);
+
+    if(ac & 0x040){
+        return DECODING_ERROR;
+    }
+    return getAltitudeCode(((ac & 0x1F80) >> 1) | (ac & 0x3F));
+}
+
+/*==============================================
+FUNCTION: getSquawk
+INPUT: a DF5/21 frame
+OUTPUT: the Mode A identity as an octal number
+(printed with %04o)
+DESCRIPTION: the identity bits (19..31) come in the
+order C1 A1 C2 A2 C4 A4 X B1 D1 B2 D2 B4 D4; each
+digit ABCD is made of its 4, 2 and 1 bits.
+================================================*/
+int getSquawk(const adsbFrame *frame){
+    int id = FRAME_getBits(frame, 19, 13);
+    int a = ((id >> 11) & 1) | ((id >> 8) & 2) | ((id >> 5) & 4);
+    int b = ((id >> 5) & 1) | ((id >> 2) & 2) | ((id << 1) & 4);
+    int c = ((id >> 12) & 1) | ((id >> 9) & 2) | ((id >> 6) & 4);
+    int d = ((id >> 4) & 1) | ((id >> 1) & 2) | ((id << 2) & 4);
+
+    return (a << 9) | (b << 6) | (c << 3) | d;
+}
+
+/*==============================================
+FUNCTION: getAddress
+INPUT: a frame
+OUTPUT: the aircraft address (ICAO)
+DESCRIPTION: DF11/17/18 announce it in bits 8..31.
+The other formats overlay the parity with it (AP),
+so the syndrome of the frame is the address.
+================================================*/
+uint32_t getAddress(const adsbFrame *frame){
+    int df = FRAME_df(frame);
+
+    if((df == 11) || (df == 17) || (df == 18)){
+        return FRAME_icao(frame);
+    }
+    return CRC_syndrome(frame->msg, FRAME_bits(frame));
+}
+
+/*==============================================
+FUNCTION: isIcaoAddress
+INPUT: a frame
+OUTPUT: 1 if the address of the frame is an ICAO
+aircraft address, 0 otherwise
+DESCRIPTION: DF18 is also sent by ground stations
+(TIS-B, ADS-R) and by non-transponder devices. Only
+the CF 0, 2 and 6 ones use the ICAO address, and
+for CF 2 and 6 the IMF bit of the position and
+velocity types flags the other addresses.
+================================================*/
+int isIcaoAddress(const adsbFrame *frame){
+    int tc = FRAME_tc(frame);
+
+    if(FRAME_df(frame) != 18){
+        return 1;
+    }
+    switch(FRAME_ca(frame)){
+        case 0:
+            return 1;
+        case 2:
+        case 6:
+            if((tc >= 5) && (tc <= 8)) return !FRAME_getBit(frame, 52);
+            if((tc >= 9) && (tc <= 18)) return !FRAME_getBit(frame, 39);
+            if(tc == 19) return !FRAME_getBit(frame, 40);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/*==============================================
+FUNCTION: decodeCommB
+INPUT: a DF20/21 frame, its aircraft (or NULL)
+OUTPUT: DECODING_OK, or DECODING_ERROR if the
+register isn't known
+DESCRIPTION: infers the register of the MB field
+(adsb_commb.c) and keeps its fields in the node.
+The true track, ground speed and barometric
+vertical rate refresh the ADS-B ones.
+================================================*/
+static int decodeCommB(const adsbFrame *frame, adsbMsg *no){
+    commbData data;
+    adsbCold *cold = NULL;
+
+    if(COMMB_decode(frame, &data) <= COMMB_UNKNOWN){
+        return DECODING_ERROR;
+    }
+    printf("BDS %d,0 =>", data.bds >> 4);
+    if(data.valid & COMMB_SEL_ALT)  printf(" selalt=%d", data.selectedAltitude);
+    if(data.valid & COMMB_BARO)     printf(" baro=%.1f", data.baroSetting);
+    if(data.valid & COMMB_ROLL)     printf(" roll=%.1f", data.roll);
+    if(data.valid & COMMB_TRACK)    printf(" track=%.1f", data.track);
+    if(data.valid & COMMB_GS)       printf(" gs=%d", data.groundSpeed);
+    if(data.valid & COMMB_TAS)      printf(" tas=%d", data.trueAirspeed);
+    if(data.valid & COMMB_HEADING)  printf(" heading=%.1f", data.heading);
+    if(data.valid & COMMB_IAS)      printf(" ias=%d", data.indicatedAirspeed);
+    if(data.valid & COMMB_MACH)     printf(" mach=%.3f", data.mach);
+    if(data.valid & COMMB_BARO_RATE) printf(" vrate=%d", data.baroRate);
+    printf("\n");
+    if(no == NULL){
+        return DECODING_OK;
+    }
+
+    cold = AIRCRAFT_cold(no);
+    if(data.valid & COMMB_SEL_ALT)  cold->selectedAltitude = data.selectedAltitude;
+    if(data.valid & COMMB_BARO)     cold->baroSetting = data.baroSetting;
+    if(data.valid & COMMB_ROLL)     cold->rollAngle = data.roll;
+    if(data.valid & COMMB_TRACK)    MSG_setHeading(no, data.track);
+    if(data.valid & COMMB_GS)       MSG_setSpeed(no, data.groundSpeed);
+    if(data.valid & COMMB_TAS)      cold->trueAirspeed = data.trueAirspeed;
+    if(data.valid & COMMB_HEADING)  cold->magneticHeading = data.heading;
+    if(data.valid & COMMB_IAS)      cold->indicatedAirspeed = data.indicatedAirspeed;
+    if(data.valid & COMMB_MACH)     cold->mach = data.mach;
+    if(data.valid & COMMB_BARO_RATE) no->verticalVelocity = data.baroRate;
+    return DECODING_OK;
+}
+
+/*==============================================
+FUNCTION: decodeReply
+INPUT: a DF4/5/20/21 frame, the messages list
+OUTPUT: DECODING_OK, or DECODING_ERROR if the
+altitude can't be decoded
+DESCRIPTION: the surveillance replies refresh the
+altitude (DF4/20) or the squawk (DF5/21) of an
+aircraft already in the list, and the Comm-B ones
+(DF20/21) the register they carry. They carry no
+position, so they don't create nodes.
+================================================*/
+static int decodeReply(const adsbFrame *frame, adsbMsg *messages){
+    char icao[7];
+    uint32_t address = getAddress(frame);
+    int df = FRAME_df(frame);
+    adsbMsg *no = NULL;
+
+    snprintf(icao, sizeof(icao), "%06X", address);
+    no = messages ? AIRCRAFT_find(address) : NULL;
+
+    if((df == 4) || (df == 20)){
+        int alt = getReplyAltitude(frame);
+        printf("DF%d ICAO:%s ALT:%d\n", df, icao, alt);
+        if(alt == DECODING_ERROR){
+            return DECODING_ERROR;
+        }
+        if(no){
+            no->Altitude = alt;
+        }
     }else{
-        return DECODING_ERROR; 
+        int squawk = getSquawk(frame);
+        printf("DF%d ICAO:%s SQUAWK:%04o\n", df, icao, squawk);
+        if(no){
+            AIRCRAFT_cold(no)->squawk = squawk;
+        }
+    }
+    if(FRAME_bits(frame) == FRAME_LONG_BITS){
+        decodeCommB(frame, no);
     }
+    return DECODING_OK;
+}
+
+/*==============================================
+FUNCTION: getAltitude
+INPUT: a frame
+OUTPUT: altitude in feet or DECODING_ERROR
+DESCRIPTION: returns the barometric altitude of an
+airborne position frame (TC 9..18), bits 40..51:
+25 ft steps if the Q bit (47) is set, Gillham code
+otherwise.
+================================================*/
+int getAltitude(const adsbFrame *frame){ 
+    if(!isPositionMessage(frame) || isSurfaceMessage(frame)){
+        return DECODING_ERROR;
+    }
+    return getAltitudeCode(FRAME_getBits(frame, 40, 12));
 }
 
 /*==============================================
 FUNCTION: setPosition
 INPUT: 
-  - msg: 28-char hex
+  - frame: the position frame
   - node: adsbMsg pointer
 OUTPUT: pointer to adsbMsg
-DESCRIPTION: sets node->oeMSG[type] + timestamps
+DESCRIPTION: sets cold->oeMSG[type], the CPR fields
++ timestamps. The messages are kept as binary frames
+(hex is only made when they are saved), and the CPR
+latitude/longitude as integers for the decoding.
 ================================================*/
-adsbMsg* setPosition(char *msg, adsbMsg *node){
-    double ctime = getCurrentTime();
-    int typeMsg = getPositionType(msg);
-
-    int sizeMsg[2];
-    sizeMsg[0] = strlen(node->oeMSG[0]);
-    sizeMsg[1] = strlen(node->oeMSG[1]);
+adsbMsg* setPosition(const adsbFrame *frame, adsbMsg *node){
+    uint32_t ctime = TIME_toTicks(getCurrentTime());
+    int typeMsg = getPositionType(frame);
+    const uint8_t kept[2] = {MSG_EVEN, MSG_ODD};
 
     // If there's a saved message of the opposite type, check if it's older than 10s
-    if(sizeMsg[!typeMsg] != 0){
-        if((ctime - node->oeTimestamp[!typeMsg]) > 10){
-            node->oeMSG[!typeMsg][0] = '\0';
+    if(node->frames & kept[!typeMsg]){
+        if(TIME_elapsed(node->oeTimestamp[!typeMsg], ctime) > 10){
+            node->frames &= ~kept[!typeMsg];
         }
     }
-    strcpy(node->oeMSG[typeMsg], msg);
-    node->oeMSG[typeMsg][28] = '\0';
+    AIRCRAFT_cold(node)->oeMSG[typeMsg] = *frame;
+    node->frames |= kept[typeMsg];
+    node->oeCPR[typeMsg][0] = getCPRLatitude(frame);
+    node->oeCPR[typeMsg][1] = getCPRLongitude(frame);
     node->oeTimestamp[typeMsg] = ctime;
     node->lastTime = typeMsg;
     return node;
@@ -349,125 +896,264 @@ int estimateNACpFromNIC(int nic) {
 }
 
 /*==============================================
-FUNCTION: decodeMessage
-INPUT:
-  - buffer: 28-char hex
-  - messages: pointer to adsbMsg list
-  - nof: pointer to pointer
-OUTPUT: updated pointer to adsbMsg list
-DESCRIPTION: the main decode function that:
-  1) checks DF=17
-  2) checks typecode
-  3) populates fields in adsbMsg
-  4) (if complete) we do NOT save to DB here,
-     but isNodeComplete(...) can be called
-     from outside
-================================================*/
-adsbMsg* decodeMessage(char* buffer, adsbMsg* messages, adsbMsg** nof) {
-    char icao[7];
-    icao[0] = '\0';
-    adsbMsg* no = NULL;
-    static adsbMsg* LastNode = NULL;
+Type code handlers of the extended squitters. Each
+one receives the frame and the aircraft and returns
+DECODING_OK or DECODING_ERROR.
+================================================*/
+typedef int (*tcHandler)(const adsbFrame *frame, adsbMsg *no);
+
+//TC 1..4
+static int decodeIdentification(const adsbFrame *frame, adsbMsg *no){
+    adsbCold *cold = AIRCRAFT_cold(no);
+
+    if (getCallsign(frame, cold->callsign) < 0) {
+        printf("Error decoding callsign!\n");
+        LOG_add("decodeMessage", "callsign couldn't be decoded");
+        return DECODING_ERROR;
+    }
+    cold->messageID = *frame;
+    no->frames |= MSG_ID;
+    printf("CALLSIGN: %s\n", cold->callsign);
+    return DECODING_OK;
+}
 
-    if ((getDownlinkFormat(buffer) == 17) && (strlen(buffer) == 28)) {
-        printf("\n\n***********ADSB MESSAGE*************\n");
-        printf("MESSAGE:%s\n", buffer);
+//Integrity of TC 5..18: partial NIC from SB nic bit, NACp estimated from it
+static void updateIntegrity(const adsbFrame *frame, adsbMsg *no){
+    adsbCold *cold = AIRCRAFT_cold(no);
+    int partialNIC = deriveNICfromTCandSBnic(FRAME_tc(frame), getSBnicBit(frame));
+    if (partialNIC >= 0 && cold->NIC == 0) {
+        cold->NIC = partialNIC;
+    }
+    if (cold->NACp == 0) {
+        cold->NACp = estimateNACpFromNIC(cold->NIC);
+        printf("Estimated NACp=%d from NIC=%d\n", cold->NACp, cold->NIC);
+    }
+}
 
-        int tc = getTypecode(buffer);
-        printf("TYPECODE:%d\n", tc);
+//TC 5..8: surface frames don't take part in the even/odd pairing
+static int decodeSurface(const adsbFrame *frame, adsbMsg *no){
+    float lat = 0, lon = 0;
+    float speed = 0, track = MSG_heading(no);
+    uint32_t now = TIME_toTicks(getCurrentTime());
 
-        getICAO(buffer, icao);
+    updateIntegrity(frame, no);
+    if (decodeSurfacePosition(frame, no, now, &lat, &lon) != DECODING_OK) {
+        return DECODING_ERROR;
+    }
+    no->Latitude = lat;
+    no->Longitude = lon;
+    no->Altitude = 0;
+    no->fixTimestamp = now;
+    no->frames |= MSG_FIX;
+    if (getSurfaceMovement(frame, &speed, &track) == DECODING_OK) {
+        MSG_setSpeed(no, speed);
+        MSG_setHeading(no, track);
+    }
+    printf("SURFACE POS => lat=%.5f lon=%.5f speed=%.1f track=%.1f\n",
+           lat, lon, MSG_speed(no), MSG_heading(no));
+    return DECODING_OK;
+}
 
-        // Insert/find node for this ICAO
-        if (!messages) {
-            messages = LIST_create(icao, &LastNode);
-            no = messages;
-        } else {
-            if ((no = LIST_insert(icao, messages, &LastNode)) == NULL) {
-                // fallback
-                if ((no = LIST_find(icao, messages)) == NULL) {
-                    perror("ICAO not found");
-                    return messages;
-                }
-            }
-        }
+//TC 9..18
+static int decodeAirborne(const adsbFrame *frame, adsbMsg *no){
+    float lat = 0, lon = 0;
+    int alt = 0;
 
-        printf("ICAO:%s\n", no->ICAO);
+    setPosition(frame, no);
+    updateIntegrity(frame, no);
+    if (decodePosition(frame, no, &lat, &lon) != DECODING_OK) {
+        return DECODING_ERROR;
+    }
+    if ((alt = getAltitude(frame)) == DECODING_ERROR) {
+        return DECODING_ERROR;
+    }
+    no->Latitude = lat;
+    no->Longitude = lon;
+    no->Altitude = alt;
+    no->fixTimestamp = no->oeTimestamp[no->lastTime];
+    no->frames |= MSG_FIX;
+    printf("POS => lat=%.5f lon=%.5f alt=%d\n", lat, lon, alt);
+    return DECODING_OK;
+}
 
-        // If it's operational status (TC=31), parse NACp, NACv, NIC, SIL, SDA
-        if (tc == 31) {
-            parseOperationalStatus(buffer, no);
-            printf("TC=31 => NACp=%d NACv=%d NIC=%d SIL=%d SDA=%d\n",
-                   no->NACp, no->NACv, no->NIC, no->SIL, no->SDA);
-        }
+//TC 19
+static int decodeVelocity(const adsbFrame *frame, adsbMsg *no){
+    adsbCold *cold = AIRCRAFT_cold(no);
+    // the fields that aren't available keep their last value
+    float heading = MSG_heading(no), vel_h = 0;
+    int rateV = no->verticalVelocity;
+    char tag[4] = "";
 
-        // If callsign (1..4)
-        if (tc >= 1 && tc <= 4) {
-            if (getCallsign(buffer, no->callsign) < 0) {
-                printf("Error decoding callsign!\n");
-                LOG_add("decodeMessage", "callsign couldn't be decoded");
-                return messages;
-            }
-            strcpy(no->messageID, buffer);
-            printf("CALLSIGN: %s\n", no->callsign);
-        }
-        // If position (TC=5..18)
-        else if (isPositionMessage(buffer)) {
-            no = setPosition(buffer, no);
-
-            // partial NIC from SB nic bit
-            int sbnicVal = getSBnicBit(buffer);
-            int partialNIC = deriveNICfromTCandSBnic(tc, sbnicVal);
-            if (partialNIC >= 0 && no->NIC == 0) {
-                no->NIC = partialNIC;
-            }
-
-            // Estimate NACp from NIC if not already set
-            if (no->NACp == 0) {
-                no->NACp = estimateNACpFromNIC(no->NIC);
-                printf("Estimated NACp=%d from NIC=%d\n", no->NACp, no->NIC);
-            }
-
-            if (strlen(no->oeMSG[0]) && strlen(no->oeMSG[1])) {
-                float lat = 0, lon = 0;
-                if (getAirbornePosition(no->oeMSG[0], no->oeMSG[1],
-                                       no->oeTimestamp[0], no->oeTimestamp[1],
-                                       &lat, &lon) == DECODING_OK) {
-                    int alt = getAltitude(buffer);
-                    if (alt > 0) {
-                        no->Latitude = lat;
-                        no->Longitude = lon;
-                        no->Altitude = alt;
-                        printf("POS => lat=%.5f lon=%.5f alt=%d\n", lat, lon, alt);
-                    }
-                }
-            }
-        }
-        // If velocity (TC=19)
-        else if (tc == 19) {
-            float heading = 0, vel_h = 0;
-            int rateV = 0;
-            char tag[4] = "";
-
-            if (getVelocities(buffer, no, &vel_h, &heading, &rateV, tag) == 0) {
-                no->horizontalVelocity = vel_h;
-                no->verticalVelocity = rateV;
-                no->groundTrackHeading = heading;
-                strcpy(no->mensagemVEL, buffer);
-                printf("VEL => speed=%.1f head=%.1f rateV=%d NACv=%d\n",
-                       vel_h, heading, rateV, no->NACv);
-            }
+    if (getVelocities(frame, cold, &vel_h, &heading, &rateV, tag) != 0) {
+        return DECODING_ERROR;
+    }
+    MSG_setSpeed(no, vel_h);
+    MSG_setHeading(no, heading);
+    no->verticalVelocity = rateV;
+    cold->mensagemVEL = *frame;
+    no->frames |= MSG_VEL;
+    printf("VEL => speed=%.1f head=%.1f rateV=%d NACv=%d\n",
+           vel_h, heading, rateV, cold->NACv);
+    return DECODING_OK;
+}
+
+//TC 31
+static int decodeOperationalStatus(const adsbFrame *frame, adsbMsg *no){
+    adsbCold *cold = AIRCRAFT_cold(no);
+
+    if (parseOperationalStatus(frame, cold) != DECODING_OK) {
+        return DECODING_ERROR;
+    }
+    printf("TC=31 => NACp=%d NACv=%d NIC=%d SIL=%d SDA=%d\n",
+           cold->NACp, cold->NACv, cold->NIC, cold->SIL, cold->SDA);
+    return DECODING_OK;
+}
+
+//Indexed by the type code; NULL for the types not decoded
+static const tcHandler tcHandlers[32] = {
+    [1] = decodeIdentification, [2] = decodeIdentification,
+    [3] = decodeIdentification, [4] = decodeIdentification,
+    [5] = decodeSurface, [6] = decodeSurface, [7] = decodeSurface, [8] = decodeSurface,
+    [9] = decodeAirborne, [10] = decodeAirborne, [11] = decodeAirborne,
+    [12] = decodeAirborne, [13] = decodeAirborne, [14] = decodeAirborne,
+    [15] = decodeAirborne, [16] = decodeAirborne, [17] = decodeAirborne,
+    [18] = decodeAirborne,
+    [19] = decodeVelocity,
+    [31] = decodeOperationalStatus
+};
+
+/*==============================================
+Downlink format handlers. Each one receives the
+frame and the aircraft list, which it may update,
+and sets *nof to the aircraft with new data to be
+saved (or NULL). They return DECODING_OK or
+DECODING_ERROR.
+================================================*/
+typedef int (*dfHandler)(const adsbFrame *frame, adsbMsg **messages, adsbMsg **nof);
+
+//DF17 (and DF18): the node of the aircraft is found (or created) and the type code dispatched
+static int decodeExtendedSquitter(const adsbFrame *frame, adsbMsg **messages, adsbMsg **nof){
+    uint32_t address = FRAME_icao(frame);
+    char hex[FRAME_HEX_LEN + 1];
+    int tc = FRAME_tc(frame);
+    adsbMsg *no = NULL;
+    int status = DECODING_ERROR;
+
+    // Hex only for the console and for the messages saved in the database
+    FRAME_toHex(frame, FRAME_LONG_BITS, hex);
+    printf("\n\n***********ADSB MESSAGE*************\n");
+    printf("MESSAGE:%s\n", hex);
+    printf("TYPECODE:%d\n", tc);
+
+    // Find/create the node of this ICAO
+    if ((no = AIRCRAFT_find(address)) == NULL) {
+        if ((no = AIRCRAFT_add(address, getCurrentTime())) == NULL) {
+            printf("Could not add the aircraft %06X\n", address);
+            return DECODING_ERROR;
         }
+    }
+    printf("ICAO:%06X\n", no->address);
 
-        no->uptadeTime = getCurrentTime();
-        if ((LastNode = LIST_orderByUpdate(no->ICAO, LastNode, &messages)) == NULL) {
-            printf("Could not reorder list\n");
+    if (tcHandlers[tc]) {
+        status = tcHandlers[tc](frame, no);
+        if (status == DECODING_OK) {
+            decStats.tcDecoded[tc]++;
+        } else {
+            decStats.tcFailed[tc]++;
         }
     } else {
-        printf("No ADS-B message => %s\n", buffer);
+        decStats.tcFailed[tc]++;
     }
-    memset(buffer, 0, 29);
+
+    AIRCRAFT_touch(no, getCurrentTime());
+    *messages = AIRCRAFT_oldest();
     *nof = no;
+    return status;
+}
+
+//DF18: the non-ICAO addresses are not kept, they could clash with an aircraft
+static int decodeNonTransponder(const adsbFrame *frame, adsbMsg **messages, adsbMsg **nof){
+    static const char *const cf_names[8] = {"ADS-B", "ADS-B non-ICAO", "TIS-B", "TIS-B coarse",
+                                            "TIS-B management", "TIS-B non-ICAO", "ADS-R", "reserved"};
+
+    printf("DF18 (%s)\n", cf_names[FRAME_ca(frame)]);
+    if (!isIcaoAddress(frame)) {
+        *nof = NULL;
+        return DECODING_ERROR;
+    }
+    return decodeExtendedSquitter(frame, messages, nof);
+}
+
+//DF4/5/20/21
+static int decodeSurveillance(const adsbFrame *frame, adsbMsg **messages, adsbMsg **nof){
+    *nof = NULL;
+    return decodeReply(frame, *messages);
+}
+
+//DF11
+static int decodeAllCall(const adsbFrame *frame, adsbMsg **messages, adsbMsg **nof){
+    (void)messages;
+    *nof = NULL;
+    printf("DF11 ICAO:%06X\n", FRAME_icao(frame));
+    return DECODING_OK;
+}
+
+//Indexed by the downlink format; NULL for the formats not decoded
+static const dfHandler dfHandlers[32] = {
+    [4] = decodeSurveillance,
+    [5] = decodeSurveillance,
+    [11] = decodeAllCall,
+    [17] = decodeExtendedSquitter,
+    [18] = decodeNonTransponder,
+    [20] = decodeSurveillance,
+    [21] = decodeSurveillance
+};
+
+/*==============================================
+FUNCTION: getDecodeStats
+INPUT: a pointer to decodeStats
+OUTPUT: the counters, passed by reference
+================================================*/
+void getDecodeStats(decodeStats *stats){
+    *stats = decStats;
+}
+
+/*==============================================
+FUNCTION: decodeMessage
+INPUT:
+  - frame: the packed frame
+  - messages: pointer to adsbMsg list
+  - nof: pointer to pointer
+OUTPUT: updated pointer to adsbMsg list
+DESCRIPTION: the main decode function. The frame
+is handed to the handler of its downlink format
+(dfHandlers) and, for the extended squitters, to
+the handler of its type code (tcHandlers), which
+populate the fields in adsbMsg. The result of each
+handler is counted per DF and per TC.
+We do NOT save to DB here: *nof is the aircraft
+with new data, and isNodeComplete(...) can be
+called from outside. The surveillance replies
+(DF4/5/20/21) only refresh the aircraft in the list
+and DF11 is only printed; for them *nof is NULL.
+================================================*/
+adsbMsg* decodeMessage(const adsbFrame *frame, adsbMsg* messages, adsbMsg** nof) {
+    int df = FRAME_df(frame);
+
+    *nof = NULL;
+    if (dfHandlers[df] == NULL) {
+        char hex[FRAME_HEX_LEN + 1];
+        FRAME_toHex(frame, FRAME_bits(frame), hex);
+        printf("No ADS-B message => %s\n", hex);
+        decStats.dfFailed[df]++;
+        return messages;
+    }
+
+    if (dfHandlers[df](frame, &messages, nof) == DECODING_OK) {
+        decStats.dfDecoded[df]++;
+    } else {
+        decStats.dfFailed[df]++;
+    }
     return messages;
 }
 /*==============================================
@@ -475,22 +1161,21 @@ FUNCTION: isNodeComplete
 INPUT: pointer to adsbMsg
 OUTPUT: pointer to adsbMsg or NULL
 DESCRIPTION: returns the node if it has at least
-two position messages (even, odd) plus altitude>0,
-and a non-empty ICAO. Then we consider it "complete."
+two position messages (even, odd) plus altitude>0.
+Then we consider it "complete." Every node has an
+address, so for now any node is saved.
 ================================================*/
 /* adsbMsg* isNodeComplete(adsbMsg *node){
     if(!node) return NULL;
-    if(strlen(node->oeMSG[0]) && strlen(node->oeMSG[1])) {
-        if(node->ICAO[0] && (node->Altitude>0)) {
+    if((node->frames & (MSG_EVEN | MSG_ODD)) == (MSG_EVEN | MSG_ODD)) {
+        if(node->Altitude>0) {
             return node;
         }
     }
     return NULL;
 } */
 adsbMsg* isNodeComplete(adsbMsg *node){
-    if(node && node->ICAO[0] != '\0')
-        return node;
-    return NULL;
+    return node;
 }
 /*==============================================
 FUNCTION: clearMinimalInfo
@@ -501,8 +1186,7 @@ reuse old alt/pos for new data
 ================================================*/
 void clearMinimalInfo(adsbMsg *node){
     if(!node) return;
-    node->oeMSG[0][0] = '\0';
-    node->oeMSG[1][0] = '\0';
+    node->frames &= ~(MSG_EVEN | MSG_ODD | MSG_FIX);
     node->Altitude = 0;
     node->Latitude = 0;
     node->Longitude=0;
@@ -510,16 +1194,12 @@ void clearMinimalInfo(adsbMsg *node){
 
 /*==============================================
 FUNCTION: getSBnicBit
-INPUT: 28-char hex
+INPUT: a frame
 OUTPUT: 0 or 1
 DESCRIPTION: example: read bit 40 for the SB nic bit
 ================================================*/
-int getSBnicBit(const char* hexMessage){
-    char binMsg[113];
-    hex2bin((char*)hexMessage, binMsg);
-    binMsg[112] = '\0';
-    char c=binMsg[SB_NIC_BIT_POS]; // define SB_NIC_BIT_POS=40 in your .h
-    return (c=='1')?1:0;
+int getSBnicBit(const adsbFrame *frame){
+    return FRAME_getBit(frame, SB_NIC_BIT_POS);
 }
 
 /*==============================================
@@ -14,32 +14,91 @@ message.
 
 /* bit offsets */
 #define SB_NIC_BIT_POS  40   // "NIC Supplement-B" is typically bit 40 in position msgs
-#define NACV_BIT_START  43   // NACv in velocity messages might be bits 43..45
+#define NACV_BIT_START  42   // NACv in velocity messages is bits 42..44
 #define NACV_BIT_LEN    3
 
+#define ATAN_TABLE_BITS 8    // 257-entry arctangent table of the track angle
+
+#define CPR_SCALE       131072   // 2^17, range of the CPR latitude/longitude fields
+
+/* local CPR decoding (one frame against a reference position) */
+#define CPR_FIX_MAX_AGE          30    // s, the last fix of the aircraft is a valid reference
+#define CPR_FIX_MAX_RANGE_NM     10    // largest move accepted from the last fix
+#define CPR_RECEIVER_MAX_RANGE_NM 180  // half a latitude zone: beyond it the decoding is ambiguous
+#define CPR_SURFACE_MAX_RANGE_NM  45   // the same for the surface frames
+
+/*==================================
+STRUCT: positionStats
+DESCRIPTION: how the airborne positions were decoded.
+	unsigned long global: even/odd pairs.
+	unsigned long local_fix: single frames against the last fix.
+	unsigned long local_receiver: single frames against the receiver.
+	unsigned long surface: surface frames, always single.
+	unsigned long undecoded: frames without a pair yet or out of range.
+===================================*/
+typedef struct{
+	unsigned long global;
+	unsigned long local_fix;
+	unsigned long local_receiver;
+	unsigned long surface;
+	unsigned long undecoded;
+}positionStats;
+
+/*==================================
+STRUCT: decodeStats
+DESCRIPTION: frames handed to the decoder, per
+downlink format and, for the extended squitters,
+per type code.
+	unsigned long dfDecoded[32], tcDecoded[32]: frames decoded.
+	unsigned long dfFailed[32], tcFailed[32]: frames that couldn't
+		be decoded, or whose format or type isn't decoded.
+===================================*/
+typedef struct{
+	unsigned long dfDecoded[32];
+	unsigned long dfFailed[32];
+	unsigned long tcDecoded[32];
+	unsigned long tcFailed[32];
+}decodeStats;
+
+#include "adsb_frame.h"
+
 typedef struct msg adsbMsg;
+typedef struct cold adsbCold;
 
-int getCallsign(char *msgi, char *msgf);
-int getVelocities(char *msgi, adsbMsg *node, float *speed, float *head, int *rateCD, char *tag);
-int isPositionMessage(char *msgi);
-int getPositionType(char *msgi);
-int getCPRLatitude(char *msgi);
-int getCPRLongitude(char *msgi);
-int getAirbornePosition(char *msgEVEN, char *msgODD, double timeE, double timeO, float *lat, float *lon);
-int getAltitude(char *msgi);
+int getCallsign(const adsbFrame *frame, char *msgf);
+int getVelocities(const adsbFrame *frame, adsbCold *cold, float *speed, float *head, int *rateCD, char *tag);
+int isPositionMessage(const adsbFrame *frame);
+int isSurfaceMessage(const adsbFrame *frame);
+int getPositionType(const adsbFrame *frame);
+int getCPRLatitude(const adsbFrame *frame);
+int getCPRLongitude(const adsbFrame *frame);
+int getNL(double lat);
+int getAirbornePosition(const int cprEVEN[2], const int cprODD[2], double timeE, double timeO, float *lat, float *lon);
+int getLocalPosition(int cprLat, int cprLon, int odd, int surface, double refLat, double refLon, double maxRange, float *lat, float *lon);
+void setReceiverPosition(double lat, double lon);
+void getPositionStats(positionStats *stats);
+void getDecodeStats(decodeStats *stats);
+int getSurfaceMovement(const adsbFrame *frame, float *speed, float *track);
+void DECODING_init(void);
+int getAltitudeCode(int code);
+int getAltitude(const adsbFrame *frame);
+int getReplyAltitude(const adsbFrame *frame);
+int getSquawk(const adsbFrame *frame);
+uint32_t getAddress(const adsbFrame *frame);
+int isIcaoAddress(const adsbFrame *frame);
 void clearMinimalInfo(adsbMsg *node);
-int parseOperationalStatus(const char *hexMessage, adsbMsg *node);
+int parseOperationalStatus(const adsbFrame *frame, adsbCold *cold);
 int estimateNACpFromNIC(int nic);
 
 /* For a position (TC=9..18) message, read bit 40 => SB nic. Returns 0 or 1. */
-int getSBnicBit(const char* hexMessage);
+int getSBnicBit(const adsbFrame *frame);
 
 /* Use the table from the doc to derive NIC from (TC + SBnic). */
 int deriveNICfromTCandSBnic(int tc, int sbnic);
 
 adsbMsg* isNodeComplete(adsbMsg *node);
-adsbMsg* setPosition(char *msg, adsbMsg *node);
-adsbMsg* decodeMessage(char* buffer, adsbMsg* messages, adsbMsg** nof);
+adsbMsg* setPosition(const adsbFrame *frame, adsbMsg *node);
+adsbMsg* decodeMessage(const adsbFrame *frame, adsbMsg* messages, adsbMsg** nof);
 
 #define PI_MATH 3.14159265358979323846
 
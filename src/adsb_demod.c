@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "adsb_demod.h"
+#include "adsb_createLog.h"
+
+//Magnitude of every possible IQ pair, indexed by the two raw bytes
+//read as one 16-bit word (in the host byte order).
+static uint16_t magTable[MAG_TABLE_SIZE];
+static int magTableReady = 0;
+
+//Kernels selected by DEMOD_init()
+static const demodKernels *kernels = &demodScalarKernels;
+
+//Preamble layout, in half-microsecond slots: pulses at 0, 1.0, 3.5
+//and 4.5 us, and the slots that must be quiet between and after them.
+static const int pulse_slots[PREAMBLE_PULSES] = {0, 2, 7, 9};
+static const int no_pulse_slots[] = {4, 5, 11, 12, 13, 14};
+
+/*==============================================
+FUNCTION: DEMOD_init
+INPUT: void
+OUTPUT: void
+DESCRIPTION: this function fills the magnitude table
+and selects the fastest kernels supported by the
+running CPU. The RTL-SDR delivers unsigned 8-bit I
+and Q values whose zero level is 127.5, so the DC
+bias is removed here, once, instead of re-centering
+every sample. Each entry is rounded to MAG_SCALE units.
+================================================*/
+void DEMOD_init(void){
+	int i = 0, q = 0;
+	uint8_t pair[2];
+	uint16_t index = 0;
+
+	if(!magTableReady){
+		for(i = 0; i < 256; i++){
+			for(q = 0; q < 256; q++){
+				float fi = (float)i - 127.5f;
+				float fq = (float)q - 127.5f;
+
+				pair[0] = (uint8_t)i;
+				pair[1] = (uint8_t)q;
+				memcpy(&index, pair, sizeof(index));
+
+				magTable[index] = (uint16_t)(sqrtf(fi*fi + fq*fq) * MAG_SCALE + 0.5f);
+			}
+		}
+		magTableReady = 1;
+	}
+
+	kernels = &demodScalarKernels;
+	for(i = 0; demodSimdKernels[i] != NULL; i++){
+		if(demodSimdKernels[i]->supported()){
+			kernels = demodSimdKernels[i];
+			break;
+		}
+	}
+	printf("Demodulator kernels: %s\n", kernels->name);
+}
+
+/*==============================================
+FUNCTION: DEMOD_useKernels
+INPUT: a kernel implementation name
+OUTPUT: 0 if selected, -1 if unknown or unsupported
+DESCRIPTION: forces one implementation of the
+kernels, e.g. "scalar" to compare against the
+reference. DEMOD_init() must be called before.
+================================================*/
+int DEMOD_useKernels(const char *name){
+	int i = 0;
+
+	if(strcmp(name, demodScalarKernels.name) == 0){
+		kernels = &demodScalarKernels;
+		return 0;
+	}
+	for(i = 0; demodSimdKernels[i] != NULL; i++){
+		if((strcmp(name, demodSimdKernels[i]->name) == 0) && demodSimdKernels[i]->supported()){
+			kernels = demodSimdKernels[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*==============================================
+FUNCTION: DEMOD_getKernels
+INPUT: void
+OUTPUT: the kernels in use
+================================================*/
+const demodKernels* DEMOD_getKernels(void){
+	return kernels;
+}
+
+/*==============================================
+FUNCTION: DEMOD_magnitude
+INPUT: the IQ buffer, the magnitude buffer and
+the number of samples
+OUTPUT: the magnitude, passed by reference
+DESCRIPTION: converts n interleaved IQ pairs
+(2*n bytes) into n magnitude values.
+================================================*/
+void DEMOD_magnitude(const uint8_t *iq, uint16_t *mag, int n){
+	kernels->magnitude(iq, mag, n);
+}
+
+/*==============================================
+FUNCTION: DEMOD_initState
+INPUT: a pointer to demodState
+OUTPUT: void
+DESCRIPTION: resets the streaming demodulator, with
+the default SNR. The buffer is allocated by the first
+DEMOD_process().
+================================================*/
+void DEMOD_initState(demodState *state){
+	memset(state, 0, sizeof(demodState));
+	DEMOD_setSNR(state, DEFAULT_SNR_DB);
+}
+
+/*==============================================
+FUNCTION: DEMOD_setSNR
+INPUT: a pointer to demodState and a value in dB
+OUTPUT: void
+DESCRIPTION: sets how far above the noise floor the
+preamble pulses must be. The ratio is kept in
+fixed point, so the hot path has no float math.
+================================================*/
+void DEMOD_setSNR(demodState *state, double snr_db){
+	state->snrRatio = (int)(256.0 * pow(10.0, snr_db / 20.0) + 0.5);
+}
+
+/*==============================================
+FUNCTION: DEMOD_pulseLevel
+INPUT: a pointer to demodState
+OUTPUT: an integer
+DESCRIPTION: returns the magnitude a preamble pulse
+must reach with the current noise floor.
+================================================*/
+int DEMOD_pulseLevel(const demodState *state){
+	int level = (int)(((long long)state->noise * state->snrRatio) >> 8);
+
+	if(level < 1){
+		level = 1;
+	}
+	if(level > 0xFFFF){
+		level = 0xFFFF;
+	}
+	return level;
+}
+
+/*==============================================
+FUNCTION: DEMOD_updateNoise
+INPUT: a pointer to demodState and a new block of
+magnitude
+OUTPUT: void
+DESCRIPTION: running noise floor estimator. Mode-S
+replies occupy a small share of the air time, so the
+mean magnitude of a block is dominated by the noise.
+The mean is taken over one sample in NOISE_DECIMATION
+and averaged exponentially over the blocks.
+================================================*/
+static void DEMOD_updateNoise(demodState *state, const uint16_t *mag, int n){
+	unsigned long long sum = 0;
+	int i = 0, count = 0, mean = 0;
+
+	for(i = 0; i < n; i += NOISE_DECIMATION){
+		sum += mag[i];
+		count++;
+	}
+	if(count == 0){
+		return;
+	}
+
+	mean = (int)(sum / count);
+	if(state->noise == 0){
+		state->noise = mean;
+	}else{
+		state->noise += (mean - state->noise) / NOISE_AVERAGING;
+	}
+}
+
+/*==============================================
+FUNCTION: DEMOD_freeState
+INPUT: a pointer to demodState
+OUTPUT: void
+DESCRIPTION: frees the buffer of the streaming
+demodulator.
+================================================*/
+void DEMOD_freeState(demodState *state){
+	free(state->mag);
+	DEMOD_initState(state);
+}
+
+/*==============================================
+FUNCTION: DEMOD_process
+INPUT: the demodulator state, an IQ block, its
+length in bytes and the function that receives
+each frame
+OUTPUT: DEMOD_OK or DEMOD_ERROR
+DESCRIPTION: converts the block to magnitude after
+the tail carried from the previous block, updates the
+noise floor, scans the block for Mode-S preambles
+whose pulses stand above it, slices the frame that
+follows each one and hands it to 'handler'. The
+first byte gives the DF, so the short frames (DF 0
+to 15) are sliced and skipped after 56 bits.
+The positions that can't hold a whole frame yet are
+carried to the next call.
+================================================*/
+int DEMOD_process(demodState *state, const uint8_t *iq, int length, DEMOD_frameHandler handler){
+	int n = length / 2;
+	int total = state->tail + n;
+	int last = 0, i = 0, level = 0;
+	adsbFrame frame;
+
+	if(total > state->capacity){
+		uint16_t *mag = (uint16_t*)realloc(state->mag, total * sizeof(uint16_t));
+		if(mag == NULL){
+			LOG_add("DEMOD_process", "magnitude buffer couldn't be allocated");
+			return DEMOD_ERROR;
+		}
+		state->mag = mag;
+		state->capacity = total;
+	}
+
+	kernels->magnitude(iq, &state->mag[state->tail], n);
+	DEMOD_updateNoise(state, &state->mag[state->tail], n);
+	level = DEMOD_pulseLevel(state);
+
+	// Positions from 'last' on are examined with the next block
+	last = total - FRAME_LEN;
+	if(last <= state->next){
+		state->tail = total;
+		return DEMOD_OK;
+	}
+
+	i = state->next;
+	while((i < last) && ((i = kernels->findPreamble(state->mag, i, last, level)) < last)){
+		const uint16_t *data = &state->mag[i + PREAMBLE_LEN];
+		int bits = 0;
+
+		kernels->sliceBits(data, frame.msg, 1);
+		bits = FRAME_bits(&frame);
+		kernels->sliceBits(&data[8 * SAMPLES_PER_MICROSEC], &frame.msg[1], bits / 8 - 1);
+		memset(&frame.msg[bits / 8], 0, DATA_BYTES - bits / 8);
+		state->frames++;
+		if(bits == FRAME_SHORT_BITS){
+			state->shortFrames++;
+		}
+		if(i < state->tail){
+			state->recovered++;
+		}
+		handler(&frame);
+
+		// Skip ahead to avoid re-detecting the same frame
+		i += PREAMBLE_LEN + bits * SAMPLES_PER_MICROSEC;
+	}
+
+	memmove(state->mag, &state->mag[last], (total - last) * sizeof(uint16_t));
+	state->tail = total - last;
+	state->next = i - last;
+
+	return DEMOD_OK;
+}
+
+/*==============================================
+FUNCTION: windowSum
+INPUT: the magnitude buffer and an index
+OUTPUT: the sum of one half-bit window
+DESCRIPTION: a pulse or a half bit lasts 0.5 us,
+that is SAMPLES_PER_HALFBIT samples.
+================================================*/
+static inline int windowSum(const uint16_t *mag, int index){
+	int sum = 0, j = 0;
+
+	for(j = 0; j < SAMPLES_PER_HALFBIT; j++){
+		sum += mag[index + j];
+	}
+	return sum;
+}
+
+/*==============================================
+FUNCTION: scalarMagnitude
+DESCRIPTION: reference magnitude kernel, through
+the lookup table.
+================================================*/
+static void scalarMagnitude(const uint8_t *iq, uint16_t *mag, int n){
+	int i = 0;
+	uint16_t index = 0;
+
+	for(i = 0; i < n; i++){
+		memcpy(&index, &iq[2*i], sizeof(index));
+		mag[i] = magTable[index];
+	}
+}
+
+/*==============================================
+FUNCTION: scalarIsPreamble
+DESCRIPTION: checks the pulse windows of a preamble
+starting at 'index': every pulse must reach 'level'
+(the noise floor raised by the SNR) and every quiet
+slot must stay below the mean pulse level. The mean
+is taken as a tree of rounded averages, like the
+SIMD averaging instructions do.
+================================================*/
+static inline int scalarIsPreamble(const uint16_t *mag, int index, int level){
+	int pulse[PREAMBLE_PULSES];
+	int p = 0, mean = 0;
+	int window = level * SAMPLES_PER_HALFBIT;
+
+	for(p = 0; p < PREAMBLE_PULSES; p++){
+		pulse[p] = windowSum(mag, index + pulse_slots[p]*SAMPLES_PER_HALFBIT);
+		if(pulse[p] < window){
+			return 0;
+		}
+	}
+
+	mean = (((pulse[0] + pulse[1] + 1) >> 1) + ((pulse[2] + pulse[3] + 1) >> 1) + 1) >> 1;
+	for(p = 0; p < (int)(sizeof(no_pulse_slots)/sizeof(int)); p++){
+		if(windowSum(mag, index + no_pulse_slots[p]*SAMPLES_PER_HALFBIT) >= mean){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*==============================================
+FUNCTION: scalarFindPreamble
+DESCRIPTION: reference preamble search kernel.
+================================================*/
+static int scalarFindPreamble(const uint16_t *mag, int from, int to, int level){
+	int i = 0;
+
+	for(i = from; i < to; i++){
+		if(scalarIsPreamble(mag, i, level)){
+			return i;
+		}
+	}
+	return to;
+}
+
+/*==============================================
+FUNCTION: scalarSliceBits
+DESCRIPTION: reference bit slicer. Each bit lasts
+1 us and carries its pulse in the first half (1) or
+in the second half (0), so the two half-bit energies
+are compared against each other, whatever the signal
+level is.
+================================================*/
+static void scalarSliceBits(const uint16_t *mag, uint8_t *bytes, int nbytes){
+	int i = 0;
+
+	memset(bytes, 0, nbytes);
+	for(i = 0; i < nbytes * 8; i++){
+		int bit_start = i * SAMPLES_PER_MICROSEC;
+		int sum_on  = windowSum(mag, bit_start);
+		int sum_off = windowSum(mag, bit_start + SAMPLES_PER_HALFBIT);
+
+		if(sum_on > sum_off){
+			bytes[i/8] |= (uint8_t)(0x80 >> (i % 8));
+		}
+	}
+}
+
+static int scalarSupported(void){
+	return 1;
+}
+
+const demodKernels demodScalarKernels = {
+	"scalar",
+	scalarSupported,
+	scalarMagnitude,
+	scalarFindPreamble,
+	scalarSliceBits
+};
@@ -0,0 +1,112 @@
+#ifndef ADSB_DEMOD_H
+#define ADSB_DEMOD_H
+
+#include <stdint.h>
+#include "adsb_frame.h"
+
+/*===============================
+These functions are responsible
+for the conversion of the raw IQ
+samples of the RTL-SDR device into
+the magnitude stream and for the
+detection and slicing of the Mode-S
+frames in that stream.
+=================================*/
+
+// Configuration defines
+#define DEFAULT_SAMPLE_RATE    2000000    // 2 MS/s
+#define DATA_LEN               112  // 112 bits for Mode-S frames
+#define DATA_BYTES             FRAME_LONG_BYTES
+#define SAMPLES_PER_MICROSEC   (DEFAULT_SAMPLE_RATE / 1000000)
+#define SAMPLES_PER_HALFBIT    (SAMPLES_PER_MICROSEC / 2)
+#define PREAMBLE_LEN           (8 * SAMPLES_PER_MICROSEC)    // 8 µs
+#define MESSAGE_LEN            (DATA_LEN * SAMPLES_PER_MICROSEC)
+#define FRAME_LEN              (PREAMBLE_LEN + MESSAGE_LEN)
+#define PREAMBLE_PULSES        4
+
+// Noise floor estimator
+#define DEFAULT_SNR_DB         6.0  // pulses must exceed the noise floor by this
+#define NOISE_DECIMATION       16   // one sample in 16 feeds the estimate
+#define NOISE_AVERAGING        8    // each block moves the floor 1/8 of the way
+
+//Status Macros
+#define DEMOD_ERROR -1
+#define DEMOD_OK     0
+
+//The magnitude is the amplitude of the sample scaled by MAG_SCALE,
+//so MAG_SCALE units correspond to one unit of the 8-bit IQ samples.
+#define MAG_SCALE       256
+#define MAG_TABLE_SIZE  65536
+
+/*==================================
+STRUCT: demodKernels
+DESCRIPTION: one implementation of the per-sample
+kernels. The scalar one is the reference; the SIMD
+ones must give exactly the same results.
+	name: implementation name (scalar, sse2, avx2, neon).
+	supported: returns 1 if the running CPU can execute it.
+	magnitude: converts n IQ pairs into n magnitudes.
+	findPreamble: returns the first index in [from, to) where
+		a preamble starts, or 'to' if there is none. Every pulse
+		must reach 'level' and every quiet slot must be below
+		the mean of the pulses.
+	sliceBits: slices nbytes*8 bits, MSB first, from the
+		magnitude of the data block, comparing the two halves
+		of each bit.
+===================================*/
+typedef struct{
+	const char *name;
+	int  (*supported)(void);
+	void (*magnitude)(const uint8_t *iq, uint16_t *mag, int n);
+	int  (*findPreamble)(const uint16_t *mag, int from, int to, int level);
+	void (*sliceBits)(const uint16_t *mag, uint8_t *bytes, int nbytes);
+}demodKernels;
+
+//SIMD implementations, best first, NULL terminated (adsb_demod_simd.c)
+extern const demodKernels *const demodSimdKernels[];
+extern const demodKernels demodScalarKernels;
+
+/*==================================
+STRUCT: demodState
+DESCRIPTION: state of the streaming demodulator. The
+last FRAME_LEN samples of each block can't hold a whole
+frame yet, so they are carried (as magnitude) in front
+of the next block and examined there. This way every
+sample position is examined exactly once and frames that
+straddle two reads are not lost.
+	uint16_t *mag: carried tail followed by the current block.
+	int capacity: samples allocated in mag.
+	int tail: samples carried from the previous block.
+	int next: first position of mag not examined yet.
+	int noise: running estimate of the noise floor (mean magnitude).
+	int snrRatio: required pulse/noise amplitude ratio, times 256.
+	unsigned long frames: frames detected.
+	unsigned long shortFrames: frames detected with 56 bits.
+	unsigned long recovered: frames that started in the carried
+		tail, i.e. that straddled a block boundary.
+===================================*/
+typedef struct{
+	uint16_t *mag;
+	int capacity;
+	int tail;
+	int next;
+	int noise;
+	int snrRatio;
+	unsigned long frames;
+	unsigned long shortFrames;
+	unsigned long recovered;
+}demodState;
+
+typedef void (*DEMOD_frameHandler)(adsbFrame *frame);
+
+void DEMOD_init(void);
+int  DEMOD_useKernels(const char *name);
+const demodKernels* DEMOD_getKernels(void);
+void DEMOD_magnitude(const uint8_t *iq, uint16_t *mag, int n);
+void DEMOD_initState(demodState *state);
+void DEMOD_setSNR(demodState *state, double snr_db);
+int  DEMOD_pulseLevel(const demodState *state);
+void DEMOD_freeState(demodState *state);
+int  DEMOD_process(demodState *state, const uint8_t *iq, int length, DEMOD_frameHandler handler);
+
+#endif
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <string.h>
+#include "adsb_demod.h"
+
+/*==============================================
+SIMD implementations of the demodulator kernels.
+Every kernel must return exactly what the scalar
+reference of adsb_demod.c returns (the bench tool
+checks it). They are written for 2 samples per
+microsecond, where a pulse or a half bit is one
+sample, and for little-endian CPUs. The x86 ones are
+compiled with target attributes, so the same binary
+runs everywhere and DEMOD_init() picks the best one
+supported by the CPU at startup.
+================================================*/
+
+#if (SAMPLES_PER_MICROSEC == 2) && (defined(__x86_64__) || defined(__i386__))
+#define DEMOD_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if (SAMPLES_PER_MICROSEC == 2) && !defined(__ARM_BIG_ENDIAN) && \
+    (defined(__aarch64__) || (defined(__arm__) && defined(__ARM_NEON)))
+#define DEMOD_SIMD_NEON
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+//Preamble sample offsets (see pulse_slots/no_pulse_slots in adsb_demod.c)
+#define P0  0
+#define P1  2
+#define P2  7
+#define P3  9
+#define Q0  4
+#define Q1  5
+#define Q2 11
+#define Q3 12
+#define Q4 13
+#define Q5 14
+
+/*==============================================
+FUNCTION: reverseByte
+DESCRIPTION: the movemask instructions return the
+first bit in the LSB, the frame is MSB first.
+================================================*/
+static inline uint8_t reverseByte(uint32_t b){
+	b = ((b & 0xF0) >> 4) | ((b & 0x0F) << 4);
+	b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2);
+	b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
+	return (uint8_t)b;
+}
+
+#ifdef DEMOD_SIMD_X86
+
+/*==============================================
+SSE2 kernels (8 samples per iteration)
+================================================*/
+__attribute__((target("sse2")))
+static inline __m128i sse2MagnitudeHalf(__m128i i32, __m128i q32){
+	const __m128 bias = _mm_set1_ps(127.5f);
+	const __m128 scale = _mm_set1_ps((float)MAG_SCALE);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	__m128 fi = _mm_sub_ps(_mm_cvtepi32_ps(i32), bias);
+	__m128 fq = _mm_sub_ps(_mm_cvtepi32_ps(q32), bias);
+	__m128 m = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(fi, fi), _mm_mul_ps(fq, fq)));
+
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(m, scale), half));
+}
+
+__attribute__((target("sse2")))
+static void sse2Magnitude(const uint8_t *iq, uint16_t *mag, int n){
+	const __m128i low = _mm_set1_epi16(0x00FF);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i offset32 = _mm_set1_epi32(32768);
+	const __m128i offset16 = _mm_set1_epi16((short)0x8000);
+	int i = 0;
+
+	for(i = 0; i + 8 <= n; i += 8){
+		__m128i raw = _mm_loadu_si128((const __m128i*)&iq[2*i]);
+		__m128i vi = _mm_and_si128(raw, low);
+		__m128i vq = _mm_srli_epi16(raw, 8);
+
+		__m128i lo = sse2MagnitudeHalf(_mm_unpacklo_epi16(vi, zero), _mm_unpacklo_epi16(vq, zero));
+		__m128i hi = sse2MagnitudeHalf(_mm_unpackhi_epi16(vi, zero), _mm_unpackhi_epi16(vq, zero));
+
+		//There is no unsigned 32->16 pack in SSE2: shift to the signed range and back
+		lo = _mm_sub_epi32(lo, offset32);
+		hi = _mm_sub_epi32(hi, offset32);
+		_mm_storeu_si128((__m128i*)&mag[i], _mm_xor_si128(_mm_packs_epi32(lo, hi), offset16));
+	}
+	demodScalarKernels.magnitude(&iq[2*i], &mag[i], n - i);
+}
+
+//mag >= level, as all-ones 16-bit lanes
+#define SSE2_GE(v, lv)  _mm_cmpeq_epi16(_mm_subs_epu16((lv), (v)), _mm_setzero_si128())
+#define SSE2_AT(k)      _mm_loadu_si128((const __m128i*)&mag[i + (k)])
+
+__attribute__((target("sse2")))
+static int sse2FindPreamble(const uint16_t *mag, int from, int to, int level){
+	const __m128i lv = _mm_set1_epi16((short)level);
+	int i = from;
+
+	for(; i + 8 <= to; i += 8){
+		__m128i p0 = SSE2_AT(P0), p1 = SSE2_AT(P1);
+		__m128i ok = _mm_and_si128(SSE2_GE(p0, lv), SSE2_GE(p1, lv));
+		if(_mm_movemask_epi8(ok) == 0){
+			continue;	//most positions are rejected by the first two pulses
+		}
+		__m128i p2 = SSE2_AT(P2), p3 = SSE2_AT(P3);
+		ok = _mm_and_si128(ok, SSE2_GE(p2, lv));
+		ok = _mm_and_si128(ok, SSE2_GE(p3, lv));
+
+		//quiet slots must be below the mean pulse level
+		__m128i mean = _mm_avg_epu16(_mm_avg_epu16(p0, p1), _mm_avg_epu16(p2, p3));
+		ok = _mm_andnot_si128(SSE2_GE(SSE2_AT(Q0), mean), ok);
+		ok = _mm_andnot_si128(SSE2_GE(SSE2_AT(Q1), mean), ok);
+		ok = _mm_andnot_si128(SSE2_GE(SSE2_AT(Q2), mean), ok);
+		ok = _mm_andnot_si128(SSE2_GE(SSE2_AT(Q3), mean), ok);
+		ok = _mm_andnot_si128(SSE2_GE(SSE2_AT(Q4), mean), ok);
+		ok = _mm_andnot_si128(SSE2_GE(SSE2_AT(Q5), mean), ok);
+
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(ok);
+		if(mask){
+			return i + (__builtin_ctz(mask) >> 1);
+		}
+	}
+	return demodScalarKernels.findPreamble(mag, i, to, level);
+}
+
+//On a little-endian CPU, each 32-bit lane holds one bit: the first half
+//in the low 16 bits and the second half in the high 16 bits. The result
+//lane is all ones if the first half is above the second one.
+__attribute__((target("sse2")))
+static inline __m128i sse2BitLanes(__m128i v){
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi32(-1);
+	__m128i on = _mm_and_si128(v, _mm_set1_epi32(0xFFFF));
+	__m128i off = _mm_srli_epi32(v, 16);
+
+	//the saturated difference is non-zero only if on > off
+	return _mm_xor_si128(_mm_cmpeq_epi32(_mm_subs_epu16(on, off), zero), ones);
+}
+
+__attribute__((target("sse2")))
+static void sse2SliceBits(const uint16_t *mag, uint8_t *bytes, int nbytes){
+	int b = 0;
+
+	for(b = 0; b < nbytes; b++){
+		__m128i v0 = _mm_loadu_si128((const __m128i*)&mag[16*b]);
+		__m128i v1 = _mm_loadu_si128((const __m128i*)&mag[16*b + 8]);
+		__m128i bits = _mm_packs_epi32(sse2BitLanes(v0), sse2BitLanes(v1));
+
+		bits = _mm_packs_epi16(bits, _mm_setzero_si128());
+		bytes[b] = reverseByte((uint32_t)_mm_movemask_epi8(bits) & 0xFF);
+	}
+}
+
+static int sse2Supported(void){
+#if defined(__x86_64__)
+	return 1;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static const demodKernels sse2Kernels = {
+	"sse2",
+	sse2Supported,
+	sse2Magnitude,
+	sse2FindPreamble,
+	sse2SliceBits
+};
+
+/*==============================================
+AVX2 kernels (16 samples per iteration). The bit
+slicer only runs once per frame, so the SSE2 one
+is reused.
+================================================*/
+__attribute__((target("avx2")))
+static inline __m256i avx2MagnitudeHalf(__m256i i32, __m256i q32){
+	const __m256 bias = _mm256_set1_ps(127.5f);
+	const __m256 scale = _mm256_set1_ps((float)MAG_SCALE);
+	const __m256 half = _mm256_set1_ps(0.5f);
+
+	__m256 fi = _mm256_sub_ps(_mm256_cvtepi32_ps(i32), bias);
+	__m256 fq = _mm256_sub_ps(_mm256_cvtepi32_ps(q32), bias);
+	__m256 m = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(fi, fi), _mm256_mul_ps(fq, fq)));
+
+	return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(m, scale), half));
+}
+
+__attribute__((target("avx2")))
+static void avx2Magnitude(const uint8_t *iq, uint16_t *mag, int n){
+	const __m256i low = _mm256_set1_epi16(0x00FF);
+	const __m256i zero = _mm256_setzero_si256();
+	int i = 0;
+
+	for(i = 0; i + 16 <= n; i += 16){
+		__m256i raw = _mm256_loadu_si256((const __m256i*)&iq[2*i]);
+		__m256i vi = _mm256_and_si256(raw, low);
+		__m256i vq = _mm256_srli_epi16(raw, 8);
+
+		//unpack and pack work inside each 128-bit lane, so the order is kept
+		__m256i lo = avx2MagnitudeHalf(_mm256_unpacklo_epi16(vi, zero), _mm256_unpacklo_epi16(vq, zero));
+		__m256i hi = avx2MagnitudeHalf(_mm256_unpackhi_epi16(vi, zero), _mm256_unpackhi_epi16(vq, zero));
+
+		_mm256_storeu_si256((__m256i*)&mag[i], _mm256_packus_epi32(lo, hi));
+	}
+	demodScalarKernels.magnitude(&iq[2*i], &mag[i], n - i);
+}
+
+#define AVX2_GE(v, lv)  _mm256_cmpeq_epi16(_mm256_subs_epu16((lv), (v)), _mm256_setzero_si256())
+#define AVX2_AT(k)      _mm256_loadu_si256((const __m256i*)&mag[i + (k)])
+
+__attribute__((target("avx2")))
+static int avx2FindPreamble(const uint16_t *mag, int from, int to, int level){
+	const __m256i lv = _mm256_set1_epi16((short)level);
+	int i = from;
+
+	for(; i + 16 <= to; i += 16){
+		__m256i p0 = AVX2_AT(P0), p1 = AVX2_AT(P1);
+		__m256i ok = _mm256_and_si256(AVX2_GE(p0, lv), AVX2_GE(p1, lv));
+		if(_mm256_movemask_epi8(ok) == 0){
+			continue;	//most positions are rejected by the first two pulses
+		}
+		__m256i p2 = AVX2_AT(P2), p3 = AVX2_AT(P3);
+		ok = _mm256_and_si256(ok, AVX2_GE(p2, lv));
+		ok = _mm256_and_si256(ok, AVX2_GE(p3, lv));
+
+		__m256i mean = _mm256_avg_epu16(_mm256_avg_epu16(p0, p1), _mm256_avg_epu16(p2, p3));
+		ok = _mm256_andnot_si256(AVX2_GE(AVX2_AT(Q0), mean), ok);
+		ok = _mm256_andnot_si256(AVX2_GE(AVX2_AT(Q1), mean), ok);
+		ok = _mm256_andnot_si256(AVX2_GE(AVX2_AT(Q2), mean), ok);
+		ok = _mm256_andnot_si256(AVX2_GE(AVX2_AT(Q3), mean), ok);
+		ok = _mm256_andnot_si256(AVX2_GE(AVX2_AT(Q4), mean), ok);
+		ok = _mm256_andnot_si256(AVX2_GE(AVX2_AT(Q5), mean), ok);
+
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(ok);
+		if(mask){
+			return i + (__builtin_ctz(mask) >> 1);
+		}
+	}
+	return sse2FindPreamble(mag, i, to, level);
+}
+
+static int avx2Supported(void){
+	return __builtin_cpu_supports("avx2");
+}
+
+static const demodKernels avx2Kernels = {
+	"avx2",
+	avx2Supported,
+	avx2Magnitude,
+	avx2FindPreamble,
+	sse2SliceBits
+};
+
+#endif /* DEMOD_SIMD_X86 */
+
+#ifdef DEMOD_SIMD_NEON
+
+/*==============================================
+NEON kernels (8 samples per iteration). ARMv7 has
+no vector square root, so there the magnitude keeps
+using the lookup table.
+================================================*/
+static void neonMagnitude(const uint8_t *iq, uint16_t *mag, int n){
+	int i = 0;
+#if defined(__aarch64__)
+	const float32x4_t bias = vdupq_n_f32(127.5f);
+	const float32x4_t scale = vdupq_n_f32((float)MAG_SCALE);
+	const float32x4_t half = vdupq_n_f32(0.5f);
+
+	for(i = 0; i + 8 <= n; i += 8){
+		uint8x8x2_t raw = vld2_u8(&iq[2*i]);
+		uint16x8_t vi = vmovl_u8(raw.val[0]);
+		uint16x8_t vq = vmovl_u8(raw.val[1]);
+
+		float32x4_t fi_lo = vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(vi))), bias);
+		float32x4_t fq_lo = vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(vq))), bias);
+		float32x4_t fi_hi = vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(vi))), bias);
+		float32x4_t fq_hi = vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(vq))), bias);
+
+		float32x4_t m_lo = vsqrtq_f32(vaddq_f32(vmulq_f32(fi_lo, fi_lo), vmulq_f32(fq_lo, fq_lo)));
+		float32x4_t m_hi = vsqrtq_f32(vaddq_f32(vmulq_f32(fi_hi, fi_hi), vmulq_f32(fq_hi, fq_hi)));
+
+		uint32x4_t r_lo = vcvtq_u32_f32(vaddq_f32(vmulq_f32(m_lo, scale), half));
+		uint32x4_t r_hi = vcvtq_u32_f32(vaddq_f32(vmulq_f32(m_hi, scale), half));
+
+		vst1q_u16(&mag[i], vcombine_u16(vmovn_u32(r_lo), vmovn_u32(r_hi)));
+	}
+#endif
+	demodScalarKernels.magnitude(&iq[2*i], &mag[i], n - i);
+}
+
+#define NEON_AT(k)  vld1q_u16(&mag[i + (k)])
+
+static int neonFindPreamble(const uint16_t *mag, int from, int to, int level){
+	const uint16x8_t lv = vdupq_n_u16((uint16_t)level);
+	int i = from;
+
+	for(; i + 8 <= to; i += 8){
+		uint16x8_t p0 = NEON_AT(P0), p1 = NEON_AT(P1);
+		uint16x8_t ok = vandq_u16(vcgeq_u16(p0, lv), vcgeq_u16(p1, lv));
+		if(vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(ok)), 0) == 0){
+			continue;	//most positions are rejected by the first two pulses
+		}
+		uint16x8_t p2 = NEON_AT(P2), p3 = NEON_AT(P3);
+		ok = vandq_u16(ok, vcgeq_u16(p2, lv));
+		ok = vandq_u16(ok, vcgeq_u16(p3, lv));
+
+		uint16x8_t mean = vrhaddq_u16(vrhaddq_u16(p0, p1), vrhaddq_u16(p2, p3));
+		ok = vandq_u16(ok, vcltq_u16(NEON_AT(Q0), mean));
+		ok = vandq_u16(ok, vcltq_u16(NEON_AT(Q1), mean));
+		ok = vandq_u16(ok, vcltq_u16(NEON_AT(Q2), mean));
+		ok = vandq_u16(ok, vcltq_u16(NEON_AT(Q3), mean));
+		ok = vandq_u16(ok, vcltq_u16(NEON_AT(Q4), mean));
+		ok = vandq_u16(ok, vcltq_u16(NEON_AT(Q5), mean));
+
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(ok)), 0);
+		if(mask){
+			return i + (__builtin_ctzll(mask) >> 3);
+		}
+	}
+	return demodScalarKernels.findPreamble(mag, i, to, level);
+}
+
+static void neonSliceBits(const uint16_t *mag, uint8_t *bytes, int nbytes){
+	static const uint8_t weights[8] = {128, 64, 32, 16, 8, 4, 2, 1};
+	const uint8x8_t w = vld1_u8(weights);
+	int b = 0;
+
+	for(b = 0; b < nbytes; b++){
+		//val[0] holds the first halves of 8 bits, val[1] the second halves
+		uint16x8x2_t s = vld2q_u16(&mag[16*b]);
+		uint16x8_t bit = vcgtq_u16(s.val[0], s.val[1]);
+		uint8x8_t weighted = vand_u8(vmovn_u16(bit), w);
+#if defined(__aarch64__)
+		bytes[b] = vaddv_u8(weighted);
+#else
+		bytes[b] = (uint8_t)vget_lane_u64(vpaddl_u32(vpaddl_u16(vpaddl_u8(weighted))), 0);
+#endif
+	}
+}
+
+static int neonSupported(void){
+#if defined(__aarch64__)
+	return 1;
+#else
+	return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+
+static const demodKernels neonKernels = {
+	"neon",
+	neonSupported,
+	neonMagnitude,
+	neonFindPreamble,
+	neonSliceBits
+};
+
+#endif /* DEMOD_SIMD_NEON */
+
+const demodKernels *const demodSimdKernels[] = {
+#ifdef DEMOD_SIMD_X86
+	&avx2Kernels,
+	&sse2Kernels,
+#endif
+#ifdef DEMOD_SIMD_NEON
+	&neonKernels,
+#endif
+	NULL
+};
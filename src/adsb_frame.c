@@ -0,0 +1,48 @@
+#include <string.h>
+#include "adsb_frame.h"
+#include "adsb_auxiliars.h"
+
+/*==============================================
+FUNCTION: FRAME_fromHex
+INPUT: a 14 or 28 hex digit string and a frame
+OUTPUT: the length of the frame in bits, or 0
+DESCRIPTION: input boundary: packs the messages
+given as hex (serial receiver, simulation) into a
+frame. Other lengths and non-hex digits return 0.
+================================================*/
+int FRAME_fromHex(const char *hex, adsbFrame *frame){
+	int bits = strlen(hex) * 4;
+	int i = 0;
+
+	if((bits != FRAME_SHORT_BITS) && (bits != FRAME_LONG_BITS)){
+		return 0;
+	}
+	if(strspn(hex, "0123456789ABCDEFabcdef") != strlen(hex)){
+		return 0;
+	}
+
+	memset(frame, 0, sizeof(adsbFrame));
+	for(i = 0; i < bits / 8; i++){
+		frame->msg[i] = (uint8_t)((hex2int(hex[2*i]) << 4) | hex2int(hex[2*i + 1]));
+	}
+	return bits;
+}
+
+/*==============================================
+FUNCTION: FRAME_toHex
+INPUT: a frame, its length in bits and a char
+vector with room for bits/4 + 1 chars
+OUTPUT: the hex string, passed by reference
+DESCRIPTION: output boundary: the uppercase hex
+form used by the console and the database.
+================================================*/
+void FRAME_toHex(const adsbFrame *frame, int bits, char *hex){
+	static const char digits[] = "0123456789ABCDEF";
+	int i = 0;
+
+	for(i = 0; i < bits / 8; i++){
+		hex[2*i]     = digits[frame->msg[i] >> 4];
+		hex[2*i + 1] = digits[frame->msg[i] & 0x0F];
+	}
+	hex[bits / 4] = '\0';
+}
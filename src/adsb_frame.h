@@ -0,0 +1,87 @@
+#ifndef ADSB_FRAME_H
+#define ADSB_FRAME_H
+
+#include <stdint.h>
+
+/*===============================
+These functions give access to
+the fields of a Mode-S frame kept
+in its packed binary form, as it
+comes out of the demodulator. The
+bits are numbered from 0 (the MSB
+of the first byte), so the DF is
+bits 0..4, the ICAO bits 8..31 and
+the ME field bits 32..87. Hex is
+only produced at the output
+boundaries (console, database).
+=================================*/
+
+#define FRAME_SHORT_BITS   56
+#define FRAME_LONG_BITS    112
+#define FRAME_SHORT_BYTES  (FRAME_SHORT_BITS / 8)
+#define FRAME_LONG_BYTES   (FRAME_LONG_BITS / 8)
+#define FRAME_HEX_LEN      (2 * FRAME_LONG_BYTES)    // without the '\0'
+
+/*==================================
+STRUCT: adsbFrame
+DESCRIPTION:
+	uint8_t msg[14]: the frame bits, MSB first. A 56-bit
+		frame uses the first 7 bytes.
+===================================*/
+typedef struct{
+	uint8_t msg[FRAME_LONG_BYTES];
+}adsbFrame;
+
+/*==============================================
+FUNCTION: FRAME_getBits
+INPUT: a frame, the first bit and the number of
+bits (1 to 32)
+OUTPUT: the field value
+DESCRIPTION: reads the 5 bytes that can hold the
+field at once and shifts it out. With constant
+arguments it compiles to a few instructions.
+================================================*/
+static inline uint32_t FRAME_getBits(const adsbFrame *frame, int first, int count){
+	int byte = first >> 3;
+	uint64_t window = 0;
+	int i = 0;
+
+	for(i = 0; i < 5; i++){
+		window = (window << 8) | ((byte + i < FRAME_LONG_BYTES) ? frame->msg[byte + i] : 0);
+	}
+	return (uint32_t)((window >> (40 - (first & 7) - count)) & ((1ULL << count) - 1));
+}
+
+static inline int FRAME_getBit(const adsbFrame *frame, int bit){
+	return (frame->msg[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+//Downlink format (bits 0..4)
+static inline int FRAME_df(const adsbFrame *frame){
+	return frame->msg[0] >> 3;
+}
+
+//Length in bits: DF 0 to 15 are short frames
+static inline int FRAME_bits(const adsbFrame *frame){
+	return (frame->msg[0] & 0x80) ? FRAME_LONG_BITS : FRAME_SHORT_BITS;
+}
+
+//Capability / code format / flight status (bits 5..7)
+static inline int FRAME_ca(const adsbFrame *frame){
+	return frame->msg[0] & 0x07;
+}
+
+//Announced address (bits 8..31) of DF11/17/18
+static inline uint32_t FRAME_icao(const adsbFrame *frame){
+	return ((uint32_t)frame->msg[1] << 16) | ((uint32_t)frame->msg[2] << 8) | frame->msg[3];
+}
+
+//Type code of the ME field (bits 32..36) of DF17/18
+static inline int FRAME_tc(const adsbFrame *frame){
+	return frame->msg[4] >> 3;
+}
+
+int  FRAME_fromHex(const char *hex, adsbFrame *frame);
+void FRAME_toHex(const adsbFrame *frame, int bits, char *hex);
+
+#endif
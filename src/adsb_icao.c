@@ -0,0 +1,120 @@
+#include <time.h>
+#include "adsb_icao.h"
+
+/*==================================
+STRUCT: icaoSlot
+DESCRIPTION:
+	uint32_t addr: the 24-bit address plus 1, so 0 is an
+		empty slot.
+	time_t seen: when the address was last seen.
+===================================*/
+typedef struct{
+	uint32_t addr;
+	time_t seen;
+}icaoSlot;
+
+static icaoSlot icaoTable[ICAO_TABLE_SIZE];
+static icaoStats stats;
+
+/*==============================================
+FUNCTION: ICAO_hash
+INPUT: a 24-bit address
+OUTPUT: its home slot
+DESCRIPTION: the addresses of a country are
+allocated in blocks, so the bits are mixed
+(multiplicative hash) before taking the slot.
+================================================*/
+static inline int ICAO_hash(uint32_t addr){
+	return (int)((addr * 2654435761u) >> 20) & (ICAO_TABLE_SIZE - 1);
+}
+
+static inline int isLive(const icaoSlot *slot, time_t now){
+	return (slot->addr != 0) && ((now - slot->seen) <= ICAO_RECENT_TIME);
+}
+
+/*==============================================
+FUNCTION: ICAO_add
+INPUT: a 24-bit address
+OUTPUT: void
+DESCRIPTION: marks the address as seen now. The
+address is kept in the first free or expired slot
+of its probe window; if all of them are live, the
+oldest one is overwritten.
+================================================*/
+void ICAO_add(uint32_t addr){
+	time_t now = time(NULL);
+	int home = ICAO_hash(addr);
+	icaoSlot *target = NULL;
+	int i = 0;
+
+	for(i = 0; i < ICAO_MAX_PROBE; i++){
+		icaoSlot *slot = &icaoTable[(home + i) & (ICAO_TABLE_SIZE - 1)];
+
+		if(slot->addr == addr + 1){
+			if(!isLive(slot, now)){
+				stats.added++;
+			}
+			slot->seen = now;
+			return;
+		}
+		if(!isLive(slot, now)){
+			if((target == NULL) || isLive(target, now)){
+				target = slot;
+			}
+		}else if((target == NULL) || (isLive(target, now) && (slot->seen < target->seen))){
+			target = slot;
+		}
+	}
+
+	if(isLive(target, now)){
+		stats.evicted++;
+	}
+	stats.added++;
+	target->addr = addr + 1;
+	target->seen = now;
+}
+
+/*==============================================
+FUNCTION: ICAO_isRecent
+INPUT: a 24-bit address
+OUTPUT: 1 if it was seen in the last
+ICAO_RECENT_TIME seconds, 0 otherwise
+================================================*/
+int ICAO_isRecent(uint32_t addr){
+	time_t now = time(NULL);
+	int home = ICAO_hash(addr);
+	int i = 0;
+
+	for(i = 0; i < ICAO_MAX_PROBE; i++){
+		const icaoSlot *slot = &icaoTable[(home + i) & (ICAO_TABLE_SIZE - 1)];
+
+		if(slot->addr == addr + 1){
+			return isLive(slot, now);
+		}
+	}
+	return 0;
+}
+
+/*==============================================
+FUNCTION: ICAO_count
+INPUT: void
+OUTPUT: the number of addresses seen recently
+================================================*/
+int ICAO_count(void){
+	time_t now = time(NULL);
+	int i = 0, count = 0;
+
+	for(i = 0; i < ICAO_TABLE_SIZE; i++){
+		count += isLive(&icaoTable[i], now);
+	}
+	return count;
+}
+
+/*==============================================
+FUNCTION: ICAO_getStats
+INPUT: a pointer to icaoStats
+OUTPUT: the counters, passed by reference
+================================================*/
+void ICAO_getStats(icaoStats *out){
+	*out = stats;
+}
@@ -0,0 +1,39 @@
+#ifndef ADSB_ICAO_H
+#define ADSB_ICAO_H
+
+#include <stdint.h>
+
+/*===============================
+These functions keep the set of
+the aircraft addresses (ICAO) seen
+recently in frames whose address
+is certain (DF11, DF17, DF18). The
+replies that overlay the parity
+with the address (DF4/5/20/21) are
+only accepted if the address they
+give is in this set.
+=================================*/
+
+#define ICAO_TABLE_SIZE   4096    // power of 2, well above the aircraft in range
+#define ICAO_MAX_PROBE    16      // slots examined from the home slot of an address
+#define ICAO_RECENT_TIME  60      // s, an address not seen for longer is forgotten
+
+/*==================================
+STRUCT: icaoStats
+DESCRIPTION:
+	unsigned long added: addresses seen for the first time
+		(or again after being forgotten).
+	unsigned long evicted: live addresses overwritten because
+		their probe window was full.
+===================================*/
+typedef struct{
+	unsigned long added;
+	unsigned long evicted;
+}icaoStats;
+
+void ICAO_add(uint32_t addr);
+int  ICAO_isRecent(uint32_t addr);
+int  ICAO_count(void);
+void ICAO_getStats(icaoStats *stats);
+
+#endif
@@ -1,11 +1,17 @@
-#include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-#include <errno.h>
 #include "adsb_lists.h"
-#include "adsb_userInfo.h"
+#include "adsb_aircraft.h"
 #include "adsb_time.h"
 
+/*==============================================
+These functions are kept for the callers that
+use the list of aircraft: they are adapters over
+the aircraft table (adsb_aircraft.c). The list is
+the chain of the table, from the least to the most
+recently updated aircraft, so the list pointers
+passed to them always end up at its first node.
+================================================*/
+
 /*==============================================
 FUNCTION: LIST_create
 INPUT: a char vector
@@ -16,40 +22,19 @@ received through adsb messages.
 ================================================*/
 
 adsbMsg* LIST_create(char *ICAO, adsbMsg**LastNode){
-	adsbMsg *msg = (adsbMsg*)malloc(sizeof(adsbMsg));
-
-	strcpy(msg->ICAO, ICAO);
-	msg->ICAO[6] = '\0';
+	adsbMsg *msg = AIRCRAFT_add((uint32_t)strtoul(ICAO, NULL, 16), getCurrentTime());
 
-	strcpy(msg->COLLECTOR_ID, collectorId);
-	msg->COLLECTOR_ID[strlen(collectorId)] = '\0';
-	
-	msg->callsign[0] = '\0';
-	msg->oeMSG[0][0] = '\0';
-	msg->oeMSG[1][0] = '\0';
-	msg->oeTimestamp[0] = 0;
-	msg->oeTimestamp[1] = 0;
-	msg->lastTime = 0;
-	msg->uptadeTime = getCurrentTime();
-	msg->Latitude = 0;	//Change 0 for -1. Verifies if nothing depends on it.
-	msg->Longitude = 0;
-	msg->Altitude = 0;
-	msg->horizontalVelocity = 0;
-	msg->verticalVelocity = 0;
-	msg->groundTrackHeading = 0;
-	msg->messageID[0] = '\0';
-	msg->mensagemVEL[0] = '\0';
-
-	msg->next = NULL;
-	*LastNode = msg;
-
-	return msg;
+	if(msg != NULL){
+		*LastNode = msg;
+	}
+	return AIRCRAFT_oldest();
 }
 
 /*==============================================
 FUNCTION: LIST_insert
 INPUT: a char vector and a list of type adsbMsg
-OUTPUT: it updates the list passed by reference
+OUTPUT: the new node, or NULL if the ICAO is
+already in the list
 DESCRIPTION: this function adds a new node to the
 list that stores aircrafts information. Each node
 is identified by the ICAO of the aircraft. This 
@@ -58,43 +43,13 @@ sharing information and all the new messages received
 is used to update the information stored in a node.
 ================================================*/
 adsbMsg *LIST_insert(char *ICAO, adsbMsg* list, adsbMsg**LastNode){
-	adsbMsg* aux1, *aux2;
+	adsbMsg *msg = AIRCRAFT_add((uint32_t)strtoul(ICAO, NULL, 16), getCurrentTime());
 
-	for(aux1 = list; aux1 != NULL; aux1 = aux1->next){	
-		if(strcmp(aux1->ICAO, ICAO) == 0){
-			perror("ICAO already exists!");
-			return NULL; 						//ICAO already exists;
-		}
-		aux2 = aux1;
+	(void)list;
+	if(msg != NULL){
+		*LastNode = msg;
 	}
-	aux2->next = (adsbMsg*)malloc(sizeof(adsbMsg));
-	aux2->next->next = NULL;            //It adds a new node in the end of the list and makes the node to point to NULL;
-
-    strcpy(aux2->next->ICAO, ICAO);
-	aux2->next->ICAO[strlen(ICAO)] = '\0';
-	
-	strcpy(aux2->next->COLLECTOR_ID, collectorId); 
-	aux2->next->COLLECTOR_ID[strlen(collectorId)] = '\0';
-
-	aux2->next->callsign[0] = '\0';
-	aux2->next->oeMSG[0][0] = '\0';
-	aux2->next->oeMSG[1][0] = '\0';
-	aux2->next->oeTimestamp[0] = 0;
-	aux2->next->oeTimestamp[1] = 0;
-	aux2->next->lastTime = 0;
-	aux2->next->uptadeTime = getCurrentTime();
-	aux2->next->Latitude = 0;
-	aux2->next->Longitude = 0;
-	aux2->next->Altitude = 0;
-	aux2->next->horizontalVelocity = 0;
-	aux2->next->verticalVelocity = 0;
-	aux2->next->groundTrackHeading = 0;
-	aux2->next->messageID[0] = '\0';
-	aux2->next->mensagemVEL[0] = '\0';
-
-	//return list;
-	*LastNode = aux2->next;
-	return aux2->next;					//SUCCESS
+	return msg;
 }
 
 /*==============================================
@@ -107,14 +62,10 @@ by the function. Or returns NULL, if no elements
 has that ICAO.
 ================================================*/
 adsbMsg* LIST_find(char* ICAO, adsbMsg* list){
-	adsbMsg* aux;
-	for(aux = list; aux != NULL; aux = aux->next){
-		if(strcmp(aux->ICAO, ICAO) == 0){
-
-			return aux;						//it found the node
-		}
+	if(list == NULL){
+		return NULL;
 	}
-	return NULL;			//the node wasn't found
+	return AIRCRAFT_find((uint32_t)strtoul(ICAO, NULL, 16));
 }
 
 /*==============================================
@@ -126,24 +77,15 @@ a list, identified by the ICAO, and deletes it. If
 the element is deleted, the resultant list is returned.
 If the element is not found, the function returns NULL.
 ================================================*/
-adsbMsg* LIST_removeOne(char* ICAO, adsbMsg** list){	//It needs be verified
-	adsbMsg* aux1 = NULL, *aux2 = NULL;
-
-	for(aux1 = *list; aux1 != NULL; aux1 = aux1->next){
-		if(strcmp(aux1->ICAO, ICAO) == 0){
-			if(aux2 == NULL){		//The ICAO belongs to the first node
-				*list = aux1->next;
-			}else{
-				aux2->next = aux1->next;	//The ICAO belongs to some intermadiate node
-			}
+adsbMsg* LIST_removeOne(char* ICAO, adsbMsg** list){
+	adsbMsg *msg = AIRCRAFT_find((uint32_t)strtoul(ICAO, NULL, 16));
 
-			free(aux1);
-			return *list;
-		}
-		aux2 = aux1;
+	if(msg == NULL){
+		return NULL;		//The node was not found
 	}
-	
-	return NULL;		//The node was not found
+	AIRCRAFT_remove(msg);
+	*list = AIRCRAFT_oldest();
+	return *list;
 }
 
 /*==============================================
@@ -154,13 +96,8 @@ DESCRIPTION: this function receives a list and
 free all its elements.
 ================================================*/
 void LIST_removeAll(adsbMsg** list){
-	adsbMsg* aux1 = *list;
-
-	while(aux1 != NULL){
-		*list = aux1->next;
-		free(aux1);
-		aux1 = *list;
-	}
+	AIRCRAFT_clear();
+	*list = NULL;
 }
 
 /*==============================================
@@ -177,36 +114,17 @@ Or it returns NULL, if it wasn't possible to sort
 the list.
 ================================================*/
 adsbMsg* LIST_orderByUpdate(char *ICAO, adsbMsg *lastNode, adsbMsg **list){
-	adsbMsg *aux1 = NULL, *aux2 = NULL;
+	adsbMsg *msg = NULL;
 
 	if(lastNode == NULL){
 		return lastNode;
 	}
-
-	//The updated node is already the last node
-	if(strcmp(ICAO, lastNode->ICAO) == 0){
-		return lastNode;
-	}
-
-	for(aux1 = *list; aux1 != NULL; aux1 = aux1->next){
-		if(strcmp(ICAO, aux1->ICAO) == 0){
-			if(aux2 == NULL){		//The ICAO belongs to the first node
-				*list = aux1->next;
-			}else{
-				aux2->next = aux1->next;	//The ICAO belongs to some intermadiate node
-			}
-
-			lastNode->next = aux1; //The previous lastNode now points to the updated node
-			lastNode = aux1;		//The lastNode is now the updated node
-			lastNode->next = NULL;
-
-			return lastNode;
-		}
-
-		aux2 = aux1;
+	if((msg = AIRCRAFT_find((uint32_t)strtoul(ICAO, NULL, 16))) == NULL){
+		return NULL;
 	}
-
-	return NULL;
+	AIRCRAFT_touch(msg, getCurrentTime());
+	*list = AIRCRAFT_oldest();
+	return msg;
 }
 
 /*==============================================
@@ -223,14 +141,6 @@ adsbMsg * LIST_delOldNodes(adsbMsg *messages){
 		return messages;
 	}
 
-	long int current_time = getCurrentTime();
-	adsbMsg *aux = messages;
-
-	while((aux != NULL) && (current_time - (aux->uptadeTime) > LIMIT_DIFF_TIME)){
-		messages = messages->next;
-		free(aux);
-		aux = messages;
-	}
-
-	return messages;
-}
\ No newline at end of file
+	AIRCRAFT_expire(getCurrentTime(), LIMIT_DIFF_TIME);
+	return AIRCRAFT_oldest();
+}
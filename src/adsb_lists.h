@@ -1,72 +1,134 @@
 #ifndef ADSB_LISTS_H
 #define ADSB_LISTS_H
 
+#include <stdint.h>
+#include "adsb_frame.h"
+
 /*===============================
 These functions are responsible
 for deal with the lists created
 in the system.
 =================================*/
 
+//Bits of adsbMsg.frames
+#define MSG_EVEN      0x01    // cold->oeMSG[0] holds an even position frame
+#define MSG_ODD       0x02    // cold->oeMSG[1] holds an odd position frame
+#define MSG_ID        0x04    // cold->messageID holds an identification frame
+#define MSG_VEL       0x08    // cold->mensagemVEL holds a velocity frame
+#define MSG_FIX       0x10    // Latitude/Longitude hold a position, fixed at fixTimestamp
+
+//Units of the velocity fields of adsbMsg
+#define MSG_SPEED_SCALE    8      // horizontalVelocity in 1/8 kt
+#define MSG_HEADING_SCALE  100    // groundTrackHeading in 0.01 degree
+
 /*==================================
 STRUCT: adsbMsg
-DESCRIPTION:
-	char COLLECTOR_ID[40]: receives the collector id.
-	char ICAO[7]: receives the unique address of the aircraft (ICAO).
-	char callsign[9]: receives the flight id (callsign).
-	
-	double oeTimestamp[2]: stores the arrive timestamp of the odd and even messages.					
-	int lastTime: indicates the last message received (even or odd).
-	
+DESCRIPTION: the state of an aircraft read and written by
+almost every frame, packed in 64 bytes (one cache line).
+The rest is in its adsbCold record (AIRCRAFT_cold()).
+The timestamps are in ms modulo 2^32 (TIME_toTicks()).
+	uint32_t prev, next: the less and the more recently updated
+		aircraft, as pool index + 1 (0: none), see adsb_aircraft.h.
+	uint32_t address: the 24-bit address of the aircraft (ICAO).
+	uint32_t uptadeTime: when the aircraft was last updated.
+	uint32_t oeTimestamp[2]: stores the arrive timestamp of the even and odd messages.
+	uint32_t fixTimestamp: the arrive timestamp of the message of the last position.
+	int32_t oeCPR[2][2]: stores the CPR latitude and longitude of the even and odd messages.
 	float Latitude: receives the aircraft latitude.
 	float Longitude: receives the aircraft longitude.
-	int Altitude: receives the aircraft altitude.
-	
-	float horizontalVelocity: receives the aircraft velocity in a horizontal direction.
-	int verticalVelocity: receives the aircraft up or down rate of movement.				
-
-	float groundTrackHeading: receives the angle for which the aircraft nose is pointing. 
-	
-	char oeMSG[2][29]: stores the even and odd messages.
-	char messageID[29]: stores the identification message.
-	char mensagemVEL[29]: stores the velocity message.	
+	int32_t Altitude: receives the aircraft altitude.
+	uint16_t horizontalVelocity: the aircraft velocity in a horizontal
+		direction, in 1/8 kt.
+	uint16_t groundTrackHeading: the angle for which the aircraft nose
+		is pointing, in 0.01 degree.
+	int16_t verticalVelocity: the aircraft up or down rate of movement (ft/min).
+	uint8_t lastTime: indicates the last message received (even or odd).
+	uint8_t frames: MSG_* bits, the frames kept and the fix.
 ===================================*/
-
 typedef struct msg{
-	char COLLECTOR_ID[40];
-	char ICAO[7];
-	char callsign[9];
-	
-	double oeTimestamp[2];
-    int lastTime;
-	double uptadeTime; //field used to order the list. It isn't sent to the server.
-    
-    //ADSB position
+	uint32_t prev;
+	uint32_t next;
+	uint32_t address;
+	uint32_t uptadeTime; //field used to order the list. It isn't sent to the server.
+	uint32_t oeTimestamp[2];
+	uint32_t fixTimestamp;
+	int32_t oeCPR[2][2];
+
+	//ADSB position
 	float Latitude;
 	float Longitude;
-	int Altitude;
-	
-	//Airplane velocity
-	float horizontalVelocity;
-	int verticalVelocity;
-
-	//Airplane angle
-	float groundTrackHeading;
-	
+	int32_t Altitude;
+
+	//Airplane velocity and angle
+	uint16_t horizontalVelocity;
+	uint16_t groundTrackHeading;
+	int16_t verticalVelocity;
+
+	uint8_t lastTime;
+	uint8_t frames;
+}adsbMsg;
+
+/*==================================
+STRUCT: adsbCold
+DESCRIPTION: the state of an aircraft that is only written
+by the rarer messages or read when it is saved.
+	char callsign[9]: receives the flight id (callsign).
+	int squawk: receives the Mode A identity (octal), from DF5/21 replies.
+
+	int selectedAltitude, float baroSetting: selected altitude (ft) and
+		pressure setting (mb), from Comm-B BDS 4,0.
+	float rollAngle, int trueAirspeed: from Comm-B BDS 5,0.
+	float magneticHeading, int indicatedAirspeed, float mach: from Comm-B BDS 6,0.
+
+	adsbFrame oeMSG[2]: stores the even and odd messages.
+	adsbFrame messageID: stores the identification message.
+	adsbFrame mensagemVEL: stores the velocity message.
+	(valid when the MSG_* bit of adsbMsg.frames is set)
+
+	int8_t NACp, NACv, NIC, SIL, SDA: quality parameters of the messages.
+===================================*/
+typedef struct cold{
+	char callsign[9];
+	int squawk;
+
+	//Comm-B (DF20/21) registers
+	int selectedAltitude;
+	float baroSetting;
+	float rollAngle;
+	int trueAirspeed;
+	float magneticHeading;
+	int indicatedAirspeed;
+	float mach;
+
 	//Original ADSB messages
-	char oeMSG[2][29];
-	char messageID[29];
-	char mensagemVEL[29];
+	adsbFrame oeMSG[2];
+	adsbFrame messageID;
+	adsbFrame mensagemVEL;
 
 	// This field store quality parameters of the message
-	int NACp; 	//Navigation Accuracy Category for Position
-	int NACv; 	//Navigation Accuracy Category for Velocity
-	int NIC; 	//Navigation Integrity Category
-	int SIL; 	//Surveillance Integrity Level
-	int SDA; 	//System Design Assurance
-	struct msg *next;
+	int8_t NACp; 	//Navigation Accuracy Category for Position
+	int8_t NACv; 	//Navigation Accuracy Category for Velocity
+	int8_t NIC; 	//Navigation Integrity Category
+	int8_t SIL; 	//Surveillance Integrity Level
+	int8_t SDA; 	//System Design Assurance
+}adsbCold;
 
-}adsbMsg;
+//Velocity fields of adsbMsg in knots and degrees
+static inline void MSG_setSpeed(adsbMsg *msg, float knots){
+	msg->horizontalVelocity = (uint16_t)(knots * MSG_SPEED_SCALE + 0.5f);
+}
+
+static inline float MSG_speed(const adsbMsg *msg){
+	return (float)msg->horizontalVelocity / MSG_SPEED_SCALE;
+}
+
+static inline void MSG_setHeading(adsbMsg *msg, float degrees){
+	msg->groundTrackHeading = (uint16_t)((int)(degrees * MSG_HEADING_SCALE + 0.5f) % (360 * MSG_HEADING_SCALE));
+}
 
+static inline float MSG_heading(const adsbMsg *msg){
+	return (float)msg->groundTrackHeading / MSG_HEADING_SCALE;
+}
 
 adsbMsg* LIST_create(char *ICAO, adsbMsg**LastNode);
 adsbMsg* LIST_insert(char *ICAO, adsbMsg* list, adsbMsg**LastNode);
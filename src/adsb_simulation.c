@@ -5,6 +5,7 @@
 // Inclusões dos headers do projeto
 #include "adsb_auxiliars.h"
 #include "adsb_lists.h"
+#include "adsb_aircraft.h"
 #include "adsb_time.h"
 #include "adsb_decoding.h"
 #include "adsb_createLog.h"
@@ -30,23 +31,25 @@ int main(void) {
     };
     int numTests = sizeof(testMessages) / sizeof(testMessages[0]);
 
-    char buffer[29];
-    buffer[28] = '\0';
+    adsbFrame frame;
     adsbMsg *node = NULL;
 
     // Log de início da simulação
     LOG_add("adsb_simulation", "Iniciando simulação de ADS-B...");
+    DECODING_init();
+    DB_init(DATABASE);
 
     // Processa cada mensagem de teste
     for (int i = 0; i < numTests; i++) {
-        // Simula a recepção de 28 bytes hex
-        strncpy(buffer, testMessages[i], 28);
-        buffer[28] = '\0';
-
-        printf("\n=== Teste %d: Mensagem = %s ===\n", i + 1, buffer);
+        // Simula a recepção: a mensagem hex é convertida para o quadro binário
+        printf("\n=== Teste %d: Mensagem = %s ===\n", i + 1, testMessages[i]);
+        if (FRAME_fromHex(testMessages[i], &frame) == 0) {
+            printf(">> Mensagem inválida.\n");
+            continue;
+        }
 
         // Chama o decodificador para atualizar a lista de mensagens
-        messagesList = decodeMessage(buffer, messagesList, &node);
+        messagesList = decodeMessage(&frame, messagesList, &node);
         if (node != NULL) {
             LOG_add("adsb_simulation", "Successfully decoded a message (node != NULL)");
             // Agora, mesmo que o nó esteja incompleto, salvamos os dados no BD.
@@ -60,15 +63,14 @@ int main(void) {
             DB_saveSystemMetrics(user_cpu, sys_cpu, max_rss);
             
             if (ret != 0) {
-                printf(">> Falha ao salvar informações para %s.\n", node->ICAO);
+                printf(">> Falha ao salvar informações para %06X.\n", node->address);
             } else {
-                printf(">> Dados da aeronave %s salvos com sucesso!\n", node->ICAO);
+                printf(">> Dados da aeronave %06X salvos com sucesso!\n", node->address);
                 clearMinimalInfo(node);
             }
         } else {
             printf(">> decodeMessage não retornou nó válido.\n");
         }
-        memset(buffer, 0, 29);
         node = NULL;
     }
 
@@ -76,13 +78,14 @@ int main(void) {
     printf("\n========== Lista final de aeronaves armazenadas ==========\n");
     adsbMsg *p = messagesList;
     while (p) {
-        printf("ICAO = %s | Callsign = %s | Lat = %f | Lon = %f | Alt = %d\n",
-               p->ICAO, p->callsign, p->Latitude, p->Longitude, p->Altitude);
-        p = p->next;
+        printf("ICAO = %06X | Callsign = %s | Lat = %f | Lon = %f | Alt = %d\n",
+               p->address, AIRCRAFT_cold(p)->callsign, p->Latitude, p->Longitude, p->Altitude);
+        p = AIRCRAFT_newer(p);
     }
 
     // Libera a memória e registra o fim da simulação
     LIST_removeAll(&messagesList);
+    DB_shutdown();
     LOG_add("adsb_simulation", "Simulação de ADS-B encerrada");
     printf("Encerrando simulador ADS-B.\n");
 
@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <rtl-sdr.h>
+#include "adsb_source.h"
+#include "adsb_capture.h"
+#include "adsb_createLog.h"
+
+//Source selected by SOURCE_open()
+static const sampleSource *source = NULL;
+static sourceStats stats;
+
+/*==============================================
+RTL-SDR device: the samples are read by the
+async capture thread (adsb_capture.c).
+================================================*/
+static rtlsdr_dev_t *dev = NULL;
+
+/*==============================================
+FUNCTION: rtlsdrOpen
+INPUT: the source configuration
+OUTPUT: SOURCE_OK or SOURCE_ERROR
+DESCRIPTION: opens and tunes the device, with the
+automatic gain, and starts the async capture.
+================================================*/
+static int rtlsdrOpen(const sourceConfig *config){
+	if(rtlsdr_open(&dev, config->device_index) < 0){
+		fprintf(stderr, "Failed to open RTL-SDR device index %d.\n", config->device_index);
+		dev = NULL;
+		return SOURCE_ERROR;
+	}
+
+	rtlsdr_set_center_freq(dev, config->frequency);
+	printf("Tuned to %u Hz.\n", config->frequency);
+
+	rtlsdr_set_sample_rate(dev, config->sample_rate);
+	printf("Sample rate set to %u Hz.\n", config->sample_rate);
+
+	rtlsdr_set_tuner_gain_mode(dev, 0);
+	rtlsdr_reset_buffer(dev);
+
+	if(CAPTURE_start(dev, config->buf_num, config->buf_len) != CAPTURE_OK){
+		rtlsdr_close(dev);
+		dev = NULL;
+		return SOURCE_ERROR;
+	}
+	return SOURCE_OK;
+}
+
+static const uint8_t* rtlsdrAcquire(int *length, int timeout_ms){
+	return CAPTURE_acquire(length, timeout_ms);
+}
+
+static void rtlsdrRelease(void){
+	CAPTURE_release();
+}
+
+static int rtlsdrIsRunning(void){
+	return CAPTURE_isRunning();
+}
+
+static void rtlsdrClose(void){
+	CAPTURE_stop();
+	if(dev){
+		rtlsdr_close(dev);
+		dev = NULL;
+	}
+}
+
+static unsigned long rtlsdrDropped(void){
+	captureStats capture;
+
+	CAPTURE_getStats(&capture);
+	return capture.dropped;
+}
+
+static const sampleSource rtlsdrSource = {
+	"rtlsdr",
+	rtlsdrOpen,
+	rtlsdrAcquire,
+	rtlsdrRelease,
+	rtlsdrIsRunning,
+	rtlsdrClose,
+	rtlsdrDropped
+};
+
+/*==============================================
+Recorded cu8 file: the whole file is mapped in
+memory and the blocks are handed out straight
+from the mapping, without any copy.
+================================================*/
+static struct{
+	const uint8_t *data;
+	size_t size;			//mapped bytes, rounded down to whole IQ pairs
+	size_t offset;			//first byte not delivered yet
+	int last;				//length of the block acquired
+	int buf_len;
+	int realtime;
+	uint32_t sample_rate;
+	struct timespec start;
+}file;
+
+/*==============================================
+FUNCTION: fileOpen
+INPUT: the source configuration
+OUTPUT: SOURCE_OK or SOURCE_ERROR
+DESCRIPTION: maps the file read-only. The kernel is
+told the access is sequential, so it reads ahead.
+================================================*/
+static int fileOpen(const sourceConfig *config){
+	struct stat st;
+	void *data = NULL;
+	int fd = 0;
+
+	memset(&file, 0, sizeof(file));
+	fd = open(config->path, O_RDONLY);
+	if(fd < 0){
+		fprintf(stderr, "Failed to open %s: %s\n", config->path, strerror(errno));
+		return SOURCE_ERROR;
+	}
+	if((fstat(fd, &st) < 0) || (st.st_size < 2)){
+		fprintf(stderr, "%s is empty or can't be read.\n", config->path);
+		close(fd);
+		return SOURCE_ERROR;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED){
+		fprintf(stderr, "Failed to map %s: %s\n", config->path, strerror(errno));
+		LOG_add("fileOpen", "IQ file couldn't be mapped");
+		return SOURCE_ERROR;
+	}
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	file.data = (const uint8_t*)data;
+	file.size = (size_t)st.st_size & ~(size_t)1;
+	file.buf_len = config->buf_len;
+	file.realtime = config->realtime;
+	file.sample_rate = config->sample_rate;
+	clock_gettime(CLOCK_MONOTONIC, &file.start);
+
+	printf("Replaying %s (%zu samples, %s).\n", config->path, file.size / 2,
+	       file.realtime ? "real-time" : "as fast as possible");
+	return SOURCE_OK;
+}
+
+/*==============================================
+FUNCTION: fileAcquire
+INPUT: a pointer to an integer and a timeout
+OUTPUT: a pointer into the mapping or NULL
+DESCRIPTION: returns the next block of the file. In
+real-time mode a block is only returned when the
+device would have delivered its last sample; if that
+is further than timeout_ms away, NULL is returned
+after waiting the timeout.
+================================================*/
+static const uint8_t* fileAcquire(int *length, int timeout_ms){
+	size_t remaining = file.size - file.offset;
+
+	*length = 0;
+	if(remaining == 0){
+		return NULL;
+	}
+	file.last = (remaining < (size_t)file.buf_len) ? (int)remaining : file.buf_len;
+
+	if(file.realtime){
+		struct timespec now, due;
+		long long samples = (long long)(file.offset + file.last) / 2;
+		long long wait_ns = 0;
+
+		due.tv_sec = file.start.tv_sec + samples / file.sample_rate;
+		due.tv_nsec = file.start.tv_nsec + (long)((samples % file.sample_rate) * 1000000000LL / file.sample_rate);
+		if(due.tv_nsec >= 1000000000L){
+			due.tv_sec++;
+			due.tv_nsec -= 1000000000L;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		wait_ns = (long long)(due.tv_sec - now.tv_sec) * 1000000000LL + (due.tv_nsec - now.tv_nsec);
+		if(wait_ns > (long long)timeout_ms * 1000000LL){
+			struct timespec pause = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+			nanosleep(&pause, NULL);
+			return NULL;
+		}
+		if(wait_ns > 0){
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+		}
+	}
+
+	*length = file.last;
+	return &file.data[file.offset];
+}
+
+static void fileRelease(void){
+	file.offset += file.last;
+	file.last = 0;
+}
+
+static int fileIsRunning(void){
+	return file.offset < file.size;
+}
+
+static void fileClose(void){
+	if(file.data){
+		munmap((void*)file.data, file.size);
+		file.data = NULL;
+	}
+}
+
+static unsigned long fileDropped(void){
+	return 0;
+}
+
+static const sampleSource fileSource = {
+	"file",
+	fileOpen,
+	fileAcquire,
+	fileRelease,
+	fileIsRunning,
+	fileClose,
+	fileDropped
+};
+
+/*==============================================
+Standard input: the samples are read into one
+buffer, e.g. from "rtl_sdr -f 1090000000 -s 2e6 -"
+or from a decompressed recording.
+================================================*/
+static struct{
+	uint8_t *buffer;
+	int buf_len;
+	int fill;				//bytes read into buffer
+	int running;
+}input;
+
+static int stdinOpen(const sourceConfig *config){
+	memset(&input, 0, sizeof(input));
+	input.buffer = (uint8_t*)malloc(config->buf_len);
+	if(input.buffer == NULL){
+		LOG_add("stdinOpen", "input buffer couldn't be allocated");
+		return SOURCE_ERROR;
+	}
+	input.buf_len = config->buf_len;
+	input.running = 1;
+	printf("Reading samples from the standard input.\n");
+	return SOURCE_OK;
+}
+
+/*==============================================
+FUNCTION: stdinAcquire
+INPUT: a pointer to an integer and a timeout
+OUTPUT: a pointer to the buffer or NULL
+DESCRIPTION: fills the buffer with whole blocks, so
+the blocks have the same length as the device ones.
+If no data arrives within timeout_ms, NULL is
+returned and the bytes read so far are kept for the
+next call. At the end of the input the last partial
+block is returned.
+================================================*/
+static const uint8_t* stdinAcquire(int *length, int timeout_ms){
+	struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+
+	*length = 0;
+	while(input.running && (input.fill < input.buf_len)){
+		ssize_t n = 0;
+
+		if(poll(&pfd, 1, timeout_ms) == 0){
+			return NULL;
+		}
+		n = read(STDIN_FILENO, &input.buffer[input.fill], input.buf_len - input.fill);
+		if(n > 0){
+			input.fill += (int)n;
+		}else if((n == 0) || ((errno != EINTR) && (errno != EAGAIN))){
+			input.running = 0;
+		}
+	}
+
+	//an odd trailing byte can only be the end of the stream
+	*length = input.fill & ~1;
+	return (*length > 0) ? input.buffer : NULL;
+}
+
+static void stdinRelease(void){
+	input.fill = 0;
+}
+
+static int stdinIsRunning(void){
+	return input.running;
+}
+
+static void stdinClose(void){
+	free(input.buffer);
+	input.buffer = NULL;
+}
+
+static unsigned long stdinDropped(void){
+	return 0;
+}
+
+static const sampleSource stdinSource = {
+	"stdin",
+	stdinOpen,
+	stdinAcquire,
+	stdinRelease,
+	stdinIsRunning,
+	stdinClose,
+	stdinDropped
+};
+
+//Indexed by the SOURCE_* types
+static const sampleSource *const sources[] = {
+	&rtlsdrSource,
+	&fileSource,
+	&stdinSource
+};
+
+/*==============================================
+FUNCTION: SOURCE_open
+INPUT: the source configuration
+OUTPUT: SOURCE_OK or SOURCE_ERROR
+DESCRIPTION: opens the source selected by
+config->type. The blocks are at most buf_len bytes
+long, which must be a multiple of 512.
+================================================*/
+int SOURCE_open(const sourceConfig *config){
+	if((config->type < 0) || (config->type >= (int)(sizeof(sources)/sizeof(sources[0])))){
+		fprintf(stderr, "Unknown sample source %d.\n", config->type);
+		return SOURCE_ERROR;
+	}
+	if((config->buf_len <= 0) || (config->buf_len % 512 != 0) || (config->sample_rate == 0)){
+		fprintf(stderr, "Invalid source configuration (buf_len=%d, sample_rate=%u)\n",
+		        config->buf_len, config->sample_rate);
+		return SOURCE_ERROR;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	source = sources[config->type];
+	if(source->open(config) != SOURCE_OK){
+		source = NULL;
+		return SOURCE_ERROR;
+	}
+	return SOURCE_OK;
+}
+
+/*==============================================
+FUNCTION: SOURCE_acquire
+INPUT: a pointer to an integer and a timeout
+OUTPUT: a pointer to the next block or NULL
+DESCRIPTION: waits up to timeout_ms for the next
+block and returns it, saving its length in 'length'.
+The block belongs to the caller until SOURCE_release()
+is called. Returns NULL on timeout or at the end of
+the stream (then SOURCE_isRunning() returns 0).
+================================================*/
+const uint8_t* SOURCE_acquire(int *length, int timeout_ms){
+	const uint8_t *block = source->acquire(length, timeout_ms);
+
+	if(block){
+		stats.blocks++;
+		stats.bytes += *length;
+	}
+	return block;
+}
+
+void SOURCE_release(void){
+	source->release();
+}
+
+int SOURCE_isRunning(void){
+	return source->isRunning();
+}
+
+/*==============================================
+FUNCTION: SOURCE_close
+INPUT: void
+OUTPUT: void
+DESCRIPTION: stops the source and frees it.
+================================================*/
+void SOURCE_close(void){
+	if(source){
+		stats.dropped = source->dropped();
+		source->close();
+		source = NULL;
+	}
+}
+
+const char* SOURCE_getName(void){
+	return source ? source->name : "none";
+}
+
+/*==============================================
+FUNCTION: SOURCE_getStats
+INPUT: a pointer to sourceStats
+OUTPUT: the counters, passed by reference
+================================================*/
+void SOURCE_getStats(sourceStats *out){
+	if(source){
+		stats.dropped = source->dropped();
+	}
+	*out = stats;
+}
@@ -0,0 +1,95 @@
+#ifndef ADSB_SOURCE_H
+#define ADSB_SOURCE_H
+
+#include <stdint.h>
+
+/*===============================
+These functions are responsible
+for delivering blocks of raw IQ
+samples (unsigned 8-bit I/Q pairs,
+the "cu8" format of the RTL-SDR) to
+the processing loop, whatever their
+origin: the RTL-SDR device, a
+recorded file or the standard input.
+=================================*/
+
+//Source types
+#define SOURCE_RTLSDR  0
+#define SOURCE_FILE    1
+#define SOURCE_STDIN   2
+
+//Status Macros
+#define SOURCE_ERROR -1
+#define SOURCE_OK     0
+
+/*==================================
+STRUCT: sourceConfig
+DESCRIPTION:
+	int type: SOURCE_RTLSDR, SOURCE_FILE or SOURCE_STDIN.
+	const char *path: file to be replayed (SOURCE_FILE).
+	int device_index: RTL-SDR device (SOURCE_RTLSDR).
+	uint32_t frequency: center frequency in Hz (SOURCE_RTLSDR).
+	uint32_t sample_rate: samples per second. The device is set to
+		it and a replayed file is paced by it.
+	int buf_num: number of async USB buffers (SOURCE_RTLSDR).
+	int buf_len: length in bytes of each block delivered.
+	int realtime: if set, a file is replayed at the sample rate
+		instead of as fast as possible.
+===================================*/
+typedef struct{
+	int type;
+	const char *path;
+	int device_index;
+	uint32_t frequency;
+	uint32_t sample_rate;
+	int buf_num;
+	int buf_len;
+	int realtime;
+}sourceConfig;
+
+/*==================================
+STRUCT: sourceStats
+DESCRIPTION:
+	unsigned long blocks: blocks delivered to the consumer.
+	unsigned long long bytes: bytes delivered to the consumer.
+	unsigned long dropped: blocks lost because the consumer was
+		too slow (live device only).
+===================================*/
+typedef struct{
+	unsigned long blocks;
+	unsigned long long bytes;
+	unsigned long dropped;
+}sourceStats;
+
+/*==================================
+STRUCT: sampleSource
+DESCRIPTION: one implementation of the sample source.
+	name: implementation name (rtlsdr, file, stdin).
+	open: prepares the source and starts the samples flow.
+	acquire: returns the next block, or NULL on timeout or
+		at the end of the stream. The block is valid until
+		release is called.
+	release: gives the last acquired block back.
+	isRunning: returns 0 once the stream has ended.
+	close: stops the source and frees its resources.
+	dropped: blocks lost so far.
+===================================*/
+typedef struct{
+	const char *name;
+	int  (*open)(const sourceConfig *config);
+	const uint8_t* (*acquire)(int *length, int timeout_ms);
+	void (*release)(void);
+	int  (*isRunning)(void);
+	void (*close)(void);
+	unsigned long (*dropped)(void);
+}sampleSource;
+
+int  SOURCE_open(const sourceConfig *config);
+const uint8_t* SOURCE_acquire(int *length, int timeout_ms);
+void SOURCE_release(void);
+int  SOURCE_isRunning(void);
+void SOURCE_close(void);
+const char* SOURCE_getName(void);
+void SOURCE_getStats(sourceStats *stats);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef ADSB_TIME_H
 #define ADSB_TIME_H
 
+#include <stdint.h>
 #include <time.h>
 #include <signal.h>
 
@@ -18,6 +19,27 @@ operations.
 #define TIMER_OK    0
 
 double getCurrentTime();
+
+/*==============================================
+The aircraft records keep their timestamps as
+"ticks": the time in ms modulo 2^32. The elapsed
+time between two ticks is exact as long as it is
+under 49 days.
+================================================*/
+static inline uint32_t TIME_toTicks(double seconds){
+	return (uint32_t)(uint64_t)(seconds * 1000.0);
+}
+
+//Seconds from the ticks 'from' to the ticks 'to'
+static inline double TIME_elapsed(uint32_t from, uint32_t to){
+	return (uint32_t)(to - from) / 1000.0;
+}
+
+//The time in seconds of past ticks, given the current time
+static inline double TIME_fromTicks(uint32_t ticks, double now){
+	return now - TIME_elapsed(ticks, TIME_toTicks(now));
+}
+
 char* getFormatedTime();
 int TIMER_setSignalHandler(void (*handler)(int, siginfo_t*, void*), int timer_signal);
 timer_t TIMER_create(int clockid, int timer_signal);
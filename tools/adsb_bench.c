@@ -0,0 +1,531 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Project headers
+#include "adsb_demod.h"
+#include "adsb_crc.h"
+#include "adsb_decoding.h"
+#include "adsb_lists.h"
+#include "adsb_aircraft.h"
+
+/*==============================================
+Microbenchmarks of the collector hot paths.
+Run "./adsb_bench" to execute all of them or
+"./adsb_bench <name> ..." to select some.
+================================================*/
+
+#define BENCH_SAMPLES     (128 * 1024)   // one default USB buffer
+#define BENCH_ITERATIONS  200
+
+typedef struct{
+	const char *name;
+	void (*run)(void);
+}benchmark;
+
+static void BENCH_magnitude(void);
+static void BENCH_kernels(void);
+static void BENCH_crc(void);
+static void BENCH_velocity(void);
+static void BENCH_aircraft(void);
+
+static const benchmark benchmarks[] = {
+	{"magnitude", BENCH_magnitude},
+	{"kernels", BENCH_kernels},
+	{"crc", BENCH_crc},
+	{"velocity", BENCH_velocity},
+	{"aircraft", BENCH_aircraft},
+};
+
+/*==============================================
+FUNCTION: BENCH_now
+INPUT: void
+OUTPUT: a double value
+DESCRIPTION: returns a monotonic timestamp in seconds.
+================================================*/
+static double BENCH_now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*==============================================
+FUNCTION: BENCH_fillIQ
+INPUT: a buffer and its length
+OUTPUT: the buffer, passed by reference
+DESCRIPTION: fills the buffer with pseudo-random
+IQ bytes around the 127.5 zero level, using a fixed
+seed so the runs are comparable.
+================================================*/
+static void BENCH_fillIQ(uint8_t *iq, int length){
+	uint32_t state = 0x12345678;
+	int i = 0;
+
+	for(i = 0; i < length; i++){
+		state = state * 1664525u + 1013904223u;
+		iq[i] = (uint8_t)(state >> 24);
+	}
+}
+
+/*==============================================
+FUNCTION: magnitudeSqrtf
+DESCRIPTION: the magnitude loop that process_samples()
+used before the lookup table, kept as the baseline.
+================================================*/
+static void magnitudeSqrtf(const uint8_t *buffer, uint8_t *magnitude, int mag_length){
+	for (int i = 0; i < mag_length; i++) {
+		int8_t I = (int8_t)(buffer[2*i]   - 127);
+		int8_t Q = (int8_t)(buffer[2*i+1] - 127);
+		float amp = sqrtf((float)(I*I + Q*Q));
+		magnitude[i] = (uint8_t)amp;
+	}
+}
+
+/*==============================================
+FUNCTION: BENCH_magnitude
+DESCRIPTION: compares the sqrtf loop against the
+lookup table of DEMOD_magnitude().
+================================================*/
+static void BENCH_magnitude(void){
+	static uint8_t iq[2 * BENCH_SAMPLES];
+	static uint8_t mag8[BENCH_SAMPLES];
+	static uint16_t mag16[BENCH_SAMPLES];
+	volatile uint32_t sink = 0;
+	double start = 0, t_sqrt = 0, t_table = 0;
+	int it = 0;
+
+	BENCH_fillIQ(iq, sizeof(iq));
+	DEMOD_init();
+	DEMOD_useKernels("scalar");
+
+	start = BENCH_now();
+	for(it = 0; it < BENCH_ITERATIONS; it++){
+		magnitudeSqrtf(iq, mag8, BENCH_SAMPLES);
+		sink += mag8[it];
+	}
+	t_sqrt = BENCH_now() - start;
+
+	start = BENCH_now();
+	for(it = 0; it < BENCH_ITERATIONS; it++){
+		DEMOD_magnitude(iq, mag16, BENCH_SAMPLES);
+		sink += mag16[it];
+	}
+	t_table = BENCH_now() - start;
+
+	double total = (double)BENCH_SAMPLES * BENCH_ITERATIONS;
+	printf("magnitude: sqrtf %.2f ns/sample (%.1f MS/s) | table %.2f ns/sample (%.1f MS/s) | speedup %.2fx\n",
+	       t_sqrt * 1e9 / total, total / t_sqrt / 1e6,
+	       t_table * 1e9 / total, total / t_table / 1e6,
+	       t_sqrt / t_table);
+	(void)sink;
+}
+
+/*==============================================
+FUNCTION: BENCH_verifyKernels
+INPUT: the kernels to be checked, the IQ buffer, its
+magnitude (from the scalar kernel) and the level
+OUTPUT: the number of mismatches
+DESCRIPTION: compares one implementation of the
+kernels against the scalar reference.
+================================================*/
+static int BENCH_verifyKernels(const demodKernels *k, const uint8_t *iq, const uint16_t *ref, int n, int level){
+	static uint16_t mag[BENCH_SAMPLES];
+	uint8_t a[DATA_BYTES], b[DATA_BYTES];
+	int errors = 0, i = 0, j = 0;
+	int last = n - (PREAMBLE_LEN + MESSAGE_LEN);
+
+	k->magnitude(iq, mag, n);
+	if(memcmp(mag, ref, n * sizeof(uint16_t)) != 0){
+		errors++;
+	}
+
+	i = j = 0;
+	while((i < last) || (j < last)){
+		i = k->findPreamble(ref, i, last, level);
+		j = demodScalarKernels.findPreamble(ref, j, last, level);
+		if(i != j){
+			errors++;
+			break;
+		}
+		if(i < last){
+			k->sliceBits(&ref[i + PREAMBLE_LEN], a, DATA_BYTES);
+			demodScalarKernels.sliceBits(&ref[i + PREAMBLE_LEN], b, DATA_BYTES);
+			if(memcmp(a, b, DATA_BYTES) != 0){
+				errors++;
+			}
+		}
+		i++;
+		j++;
+	}
+	return errors;
+}
+
+/*==============================================
+FUNCTION: BENCH_kernels
+DESCRIPTION: checks every SIMD implementation
+supported by this CPU against the scalar one and
+times the magnitude and preamble search kernels.
+================================================*/
+static void BENCH_kernels(void){
+	static uint8_t iq[2 * BENCH_SAMPLES];
+	static uint16_t ref[BENCH_SAMPLES], mag[BENCH_SAMPLES];
+	const demodKernels *list[8];
+	volatile int sink = 0;
+	int count = 0, i = 0, it = 0;
+	//with this level about 100 positions of the random buffer pass the
+	//preamble test, so the search and the slicer are both exercised
+	int level = 130 * MAG_SCALE;
+	int last = BENCH_SAMPLES - (PREAMBLE_LEN + MESSAGE_LEN);
+
+	BENCH_fillIQ(iq, sizeof(iq));
+	DEMOD_init();
+	demodScalarKernels.magnitude(iq, ref, BENCH_SAMPLES);
+
+	list[count++] = &demodScalarKernels;
+	for(i = 0; (demodSimdKernels[i] != NULL) && (count < 8); i++){
+		if(demodSimdKernels[i]->supported()){
+			list[count++] = demodSimdKernels[i];
+		}
+	}
+
+	for(i = 0; i < count; i++){
+		const demodKernels *k = list[i];
+		double start = 0, t_mag = 0, t_pre = 0;
+		int errors = BENCH_verifyKernels(k, iq, ref, BENCH_SAMPLES, level);
+
+		start = BENCH_now();
+		for(it = 0; it < BENCH_ITERATIONS; it++){
+			k->magnitude(iq, mag, BENCH_SAMPLES);
+			sink += mag[it];
+		}
+		t_mag = BENCH_now() - start;
+
+		//level above any noise sample: the search scans the whole buffer
+		start = BENCH_now();
+		for(it = 0; it < BENCH_ITERATIONS; it++){
+			sink += k->findPreamble(ref, 0, last, 200 * MAG_SCALE);
+		}
+		t_pre = BENCH_now() - start;
+
+		double total = (double)BENCH_SAMPLES * BENCH_ITERATIONS;
+		printf("kernels %-6s: magnitude %.2f ns/sample | preamble search %.2f ns/sample | %s\n",
+		       k->name, t_mag * 1e9 / total, t_pre * 1e9 / total,
+		       errors ? "MISMATCH with scalar" : "matches scalar");
+	}
+	(void)sink;
+}
+
+/*==============================================
+FUNCTION: crcVerifyString
+DESCRIPTION: the division that CRC_verifyMsg() did
+before the table, on the message expanded to a '0'/'1'
+string (without its printf of the remainder), kept as
+the baseline.
+================================================*/
+static int crcVerifyString(const uint8_t *msg, int bits){
+	static const char generator[] = "1111111111111010000001001";
+	char msgbin[CRC_LONG_BITS + 1];
+	int i = 0, j = 0;
+
+	for(i = 0; i < bits; i++){
+		msgbin[i] = ((msg[i / 8] >> (7 - (i % 8))) & 1) ? '1' : '0';
+	}
+	msgbin[bits] = '\0';
+
+	for(i = 0; i < bits - CRC_PARITY_BITS; i++){
+		if(msgbin[i] == '1'){
+			for(j = 0; j < (int)sizeof(generator) - 1; j++){
+				msgbin[i + j] = ((msgbin[i + j] - '0') ^ (generator[j] - '0')) ? '1' : '0';
+			}
+		}
+	}
+	for(i = 0; i < bits; i++){
+		if(msgbin[i] == '1'){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*==============================================
+FUNCTION: BENCH_crc
+DESCRIPTION: compares the character-by-character
+division against the table-driven CRC_syndrome()
+on random 112-bit frames.
+================================================*/
+static void BENCH_crc(void){
+	enum{ FRAMES = 4096 };
+	static uint8_t frames[FRAMES][CRC_LONG_BITS / 8];
+	volatile uint32_t sink = 0;
+	double start = 0, t_string = 0, t_table = 0;
+	int it = 0, i = 0, errors = 0;
+
+	BENCH_fillIQ(&frames[0][0], sizeof(frames));
+
+	for(i = 0; i < FRAMES; i++){
+		errors += crcVerifyString(frames[i], CRC_LONG_BITS) != (CRC_syndrome(frames[i], CRC_LONG_BITS) == 0);
+	}
+
+	start = BENCH_now();
+	for(it = 0; it < BENCH_ITERATIONS / 10; it++){
+		for(i = 0; i < FRAMES; i++){
+			sink += crcVerifyString(frames[i], CRC_LONG_BITS);
+		}
+	}
+	t_string = BENCH_now() - start;
+
+	start = BENCH_now();
+	for(it = 0; it < BENCH_ITERATIONS / 10; it++){
+		for(i = 0; i < FRAMES; i++){
+			sink += CRC_syndrome(frames[i], CRC_LONG_BITS);
+		}
+	}
+	t_table = BENCH_now() - start;
+
+	double total = (double)FRAMES * (BENCH_ITERATIONS / 10);
+	printf("crc: string %.1f ns/frame | table %.1f ns/frame | speedup %.1fx | %s\n",
+	       t_string * 1e9 / total, t_table * 1e9 / total, t_string / t_table,
+	       errors ? "MISMATCH" : "results match");
+	(void)sink;
+}
+
+/*==============================================
+FUNCTION: velocityFloat
+DESCRIPTION: the ground speed and track as
+getVelocities() computed them before the integer
+version (sqrtf, atan2f), kept as the baseline.
+================================================*/
+static void velocityFloat(const adsbFrame *frame, float *speed, float *head){
+	int ew = (int)FRAME_getBits(frame, 46, 10) - 1;
+	int ns = (int)FRAME_getBits(frame, 57, 10) - 1;
+
+	if(FRAME_getBit(frame, 45)) ew = -ew;
+	if(FRAME_getBit(frame, 56)) ns = -ns;
+	*speed = sqrtf((float)(ew*ew + ns*ns));
+	*head = atan2f((float)ew, (float)ns) * 180.0f / PI_MATH;
+	if(*head < 0) *head += 360;
+}
+
+/*==============================================
+FUNCTION: BENCH_velocity
+DESCRIPTION: compares the float speed and track
+against the integer getVelocities() on random
+subtype 1 velocity frames.
+================================================*/
+static void BENCH_velocity(void){
+	enum{ FRAMES = 4096 };
+	static adsbFrame frames[FRAMES];
+	adsbCold cold;
+	volatile float sink = 0;
+	double start = 0, t_float = 0, t_int = 0, max_head = 0, max_speed = 0;
+	float speed = 0, head = 0, ispeed = 0, ihead = 0;
+	int rate = 0, it = 0, i = 0;
+	char tag[4];
+
+	DECODING_init();
+	memset(&cold, 0, sizeof(cold));
+	BENCH_fillIQ(&frames[0].msg[0], sizeof(frames));
+	for(i = 0; i < FRAMES; i++){
+		frames[i].msg[0] = 0x8D;                // DF17
+		frames[i].msg[4] = (19 << 3) | 1;       // TC19, subtype 1
+		frames[i].msg[6] |= 0x01;               // E/W velocity (bits 46..55) never 0, not available
+		frames[i].msg[8] |= 0x20;               // N/S velocity (bits 57..66) never 0
+	}
+
+	for(i = 0; i < FRAMES; i++){
+		double diff = 0;
+
+		velocityFloat(&frames[i], &speed, &head);
+		getVelocities(&frames[i], &cold, &ispeed, &ihead, &rate, tag);
+		diff = fabs(head - ihead);
+		if(diff > 180) diff = 360 - diff;
+		if(diff > max_head) max_head = diff;
+		if(fabs(speed - ispeed) > max_speed) max_speed = fabs(speed - ispeed);
+	}
+
+	start = BENCH_now();
+	for(it = 0; it < BENCH_ITERATIONS; it++){
+		for(i = 0; i < FRAMES; i++){
+			velocityFloat(&frames[i], &speed, &head);
+			sink += speed + head;
+		}
+	}
+	t_float = BENCH_now() - start;
+
+	start = BENCH_now();
+	for(it = 0; it < BENCH_ITERATIONS; it++){
+		for(i = 0; i < FRAMES; i++){
+			getVelocities(&frames[i], &cold, &ispeed, &ihead, &rate, tag);
+			sink += ispeed + ihead;
+		}
+	}
+	t_int = BENCH_now() - start;
+
+	double total = (double)FRAMES * BENCH_ITERATIONS;
+	printf("velocity: float %.1f ns/frame | integer %.1f ns/frame | speedup %.1fx | max error %.3f deg %.2f kt\n",
+	       t_float * 1e9 / total, t_int * 1e9 / total, t_float / t_int, max_head, max_speed);
+	(void)sink;
+}
+
+/*==================================
+STRUCT: legacyMsg
+DESCRIPTION: the aircraft record before the hot/cold split
+(one malloc per aircraft), kept as the baseline.
+===================================*/
+typedef struct legacy{
+	char COLLECTOR_ID[40];
+	char ICAO[7];
+	char callsign[9];
+	double oeTimestamp[2];
+	int oeCPR[2][2];
+	int lastTime;
+	double uptadeTime;
+	double fixTimestamp;
+	float Latitude;
+	float Longitude;
+	int Altitude;
+	float horizontalVelocity;
+	int verticalVelocity;
+	float groundTrackHeading;
+	int squawk;
+	int selectedAltitude;
+	float baroSetting;
+	float rollAngle;
+	int trueAirspeed;
+	float magneticHeading;
+	int indicatedAirspeed;
+	float mach;
+	char oeMSG[2][29];
+	char messageID[29];
+	char mensagemVEL[29];
+	int NACp, NACv, NIC, SIL, SDA;
+	struct legacy *next;
+}legacyMsg;
+
+//What a position and a velocity frame do to the record
+static void updateLegacy(legacyMsg *m, uint32_t r){
+	int odd = r & 1;
+
+	m->oeCPR[odd][0] = r & 0x1FFFF;
+	m->oeCPR[odd][1] = (r >> 8) & 0x1FFFF;
+	m->oeTimestamp[odd] = r;
+	if(m->oeTimestamp[odd] - m->fixTimestamp <= 30){
+		m->Latitude += 0.001f;
+		m->Longitude += 0.001f;
+	}
+	m->fixTimestamp = m->oeTimestamp[odd];
+	m->Altitude = r & 0xFFFF;
+	m->horizontalVelocity = (float)(r & 0x1FF);
+	m->groundTrackHeading = (float)(r % 360);
+	m->verticalVelocity = (int)(r & 0x3F) * 64;
+	m->uptadeTime = r;
+}
+
+static void updateRecord(adsbMsg *m, uint32_t r){
+	int odd = r & 1;
+
+	m->oeCPR[odd][0] = r & 0x1FFFF;
+	m->oeCPR[odd][1] = (r >> 8) & 0x1FFFF;
+	m->oeTimestamp[odd] = r;
+	if(m->oeTimestamp[odd] - m->fixTimestamp <= 30000){
+		m->Latitude += 0.001f;
+		m->Longitude += 0.001f;
+	}
+	m->fixTimestamp = m->oeTimestamp[odd];
+	m->Altitude = r & 0xFFFF;
+	m->horizontalVelocity = (uint16_t)((r & 0x1FF) * MSG_SPEED_SCALE);
+	m->groundTrackHeading = (uint16_t)((r % 360) * MSG_HEADING_SCALE);
+	m->verticalVelocity = (int16_t)((r & 0x3F) * 64);
+	m->uptadeTime = r;
+}
+
+/*==============================================
+FUNCTION: BENCH_aircraft
+DESCRIPTION: updates the kinematic state of
+aircraft picked at random, as the frames of a few
+thousand aircraft do, with the old records (250
+bytes, one malloc each) and with the hot records of
+the pool (one cache line). The aircraft are reached
+through pointers, so only the layout is measured.
+================================================*/
+static void BENCH_aircraft(void){
+	static const int sizes[] = {4096, 16384};
+	enum{ UPDATES = 1 << 22 };
+	int k = 0;
+
+	for(k = 0; k < (int)(sizeof(sizes)/sizeof(sizes[0])); k++){
+		int n = sizes[k], i = 0;
+		legacyMsg **legacy = (legacyMsg**)malloc(n * sizeof(legacyMsg*));
+		adsbMsg **records = (adsbMsg**)malloc(n * sizeof(adsbMsg*));
+		double start = 0, t_legacy = 0, t_records = 0;
+		uint32_t state = 0x12345678;
+
+		if((legacy == NULL) || (records == NULL) || (AIRCRAFT_init(n) != AIRCRAFT_OK)){
+			printf("aircraft: out of memory\n");
+			free(legacy);
+			free(records);
+			return;
+		}
+		for(i = 0; i < n; i++){
+			legacy[i] = (legacyMsg*)calloc(1, sizeof(legacyMsg));
+			records[i] = AIRCRAFT_add(0x400000 + i, 0);
+		}
+
+		start = BENCH_now();
+		for(i = 0; i < UPDATES; i++){
+			state = state * 1664525u + 1013904223u;
+			updateLegacy(legacy[(state >> 8) % n], state);
+		}
+		t_legacy = BENCH_now() - start;
+
+		state = 0x12345678;
+		start = BENCH_now();
+		for(i = 0; i < UPDATES; i++){
+			state = state * 1664525u + 1013904223u;
+			updateRecord(records[(state >> 8) % n], state);
+		}
+		t_records = BENCH_now() - start;
+
+		printf("aircraft (%d): %zu-byte records %.1f ns/update | %zu-byte hot records %.1f ns/update | speedup %.1fx\n",
+		       n, sizeof(legacyMsg), t_legacy * 1e9 / UPDATES, sizeof(adsbMsg), t_records * 1e9 / UPDATES,
+		       t_legacy / t_records);
+
+		for(i = 0; i < n; i++){
+			free(legacy[i]);
+		}
+		free(legacy);
+		free(records);
+		AIRCRAFT_clear();
+	}
+}
+
+int main(int argc, char **argv){
+	int n = sizeof(benchmarks) / sizeof(benchmarks[0]);
+	int i = 0, j = 0, found = 0;
+
+	for(i = 0; i < n; i++){
+		if(argc < 2){
+			benchmarks[i].run();
+			continue;
+		}
+		for(j = 1; j < argc; j++){
+			if(strcmp(argv[j], benchmarks[i].name) == 0){
+				benchmarks[i].run();
+				found++;
+			}
+		}
+	}
+
+	if((argc >= 2) && (found == 0)){
+		fprintf(stderr, "Unknown benchmark. Available:");
+		for(i = 0; i < n; i++){
+			fprintf(stderr, " %s", benchmarks[i].name);
+		}
+		fprintf(stderr, "\n");
+		return 1;
+	}
+	return 0;
+}
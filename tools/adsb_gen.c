@@ -0,0 +1,690 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+// Project headers
+#include "adsb_crc.h"
+
+/*==============================================
+Synthetic Mode-S signal generator. It writes raw
+"cu8" IQ samples (what the RTL-SDR delivers and
+what "run_collector --file" replays) holding
+PPM-encoded DF17 (identification, airborne position
+and velocity), DF11 and DF4 frames from a set of
+simulated aircraft, over white gaussian noise. Each
+frame gets the SNR and the carrier frequency offset
+of its aircraft, frames from different aircraft may
+overlap and the ground truth of every frame is
+written to a CSV file, so the detection probability,
+the false decodes and the CPU cost per frame of the
+demodulator can be measured.
+
+Run "./adsb_gen -h" for the options.
+================================================*/
+
+#define GEN_DEFAULT_RATE       2000000    // samples per second
+#define GEN_DEFAULT_DURATION   10.0       // seconds
+#define GEN_DEFAULT_AIRCRAFT   300
+#define GEN_DEFAULT_MSG_RATE   6.0        // frames per second per aircraft
+#define GEN_DEFAULT_SNR_MIN    6.0        // dB
+#define GEN_DEFAULT_SNR_MAX    30.0       // dB
+#define GEN_DEFAULT_NOISE      3.0        // noise RMS per component, in IQ units
+#define GEN_DEFAULT_FREQ       0.0        // maximum carrier offset, Hz
+#define GEN_DEFAULT_LAT        -3.7319    // receiver position
+#define GEN_DEFAULT_LON        -38.5267
+#define GEN_RANGE_KM           300.0      // aircraft are placed up to this far
+#define GEN_BLOCK_SAMPLES      (1 << 20)  // samples synthesized at a time
+
+#define PREAMBLE_US            8.0
+#define FRAME_US(bits)         (PREAMBLE_US + (bits))
+
+//Frame kinds (share of the traffic in GEN_pickKind())
+#define KIND_IDENT      0   // DF17 TC 4
+#define KIND_POSITION   1   // DF17 TC 11
+#define KIND_VELOCITY   2   // DF17 TC 19
+#define KIND_ALLCALL    3   // DF11
+#define KIND_ALTITUDE   4   // DF4
+
+/*==================================
+STRUCT: genAircraft
+DESCRIPTION: one simulated aircraft. It flies in a
+straight line at constant altitude.
+===================================*/
+typedef struct{
+	uint32_t icao;
+	char callsign[9];
+	double lat, lon;		//position at t = 0
+	double vn, ve;			//velocity in knots (north, east)
+	int altitude;			//feet
+	int vrate;				//feet per minute
+	double snr;				//dB
+	double freq;			//carrier offset, Hz
+	int odd;				//next position frame is odd
+}genAircraft;
+
+/*==================================
+STRUCT: genFrame
+DESCRIPTION: one frame in the air.
+	double start: time of the first preamble pulse, in us.
+	uint8_t msg[14]: the bits, MSB first.
+	int bits: 56 or 112.
+	int aircraft: index of the sender.
+	int kind: KIND_*.
+	double amplitude, phase: carrier at the start.
+	int overlapped: another frame shares the air time.
+===================================*/
+typedef struct{
+	double start;
+	uint8_t msg[14];
+	int bits;
+	int aircraft;
+	int kind;
+	double amplitude;
+	double phase;
+	int overlapped;
+}genFrame;
+
+//Options
+static double rate = GEN_DEFAULT_RATE;
+static double duration = GEN_DEFAULT_DURATION;
+static int n_aircraft = GEN_DEFAULT_AIRCRAFT;
+static double msg_rate = GEN_DEFAULT_MSG_RATE;
+static double snr_min = GEN_DEFAULT_SNR_MIN, snr_max = GEN_DEFAULT_SNR_MAX;
+static double noise = GEN_DEFAULT_NOISE;
+static double max_freq = GEN_DEFAULT_FREQ;
+static double overlap = 0.0;
+static double center_lat = GEN_DEFAULT_LAT, center_lon = GEN_DEFAULT_LON;
+static int aligned = 0;
+static uint64_t seed = 1;
+static const char *truth_path = NULL;
+
+static uint64_t rng_state = 1;
+
+/*==============================================
+FUNCTION: GEN_random
+INPUT: void
+OUTPUT: a 64-bit pseudo-random value
+DESCRIPTION: xorshift64*, so a seed always gives
+the same output on every machine.
+================================================*/
+static uint64_t GEN_random(void){
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+//uniform in [0, 1)
+static double GEN_uniform(void){
+	return (GEN_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//standard normal, Box-Muller (the second value is kept for the next call)
+static double GEN_gaussian(void){
+	static int has_spare = 0;
+	static double spare = 0;
+	double u = 0, v = 0, r = 0;
+
+	if(has_spare){
+		has_spare = 0;
+		return spare;
+	}
+	do{
+		u = GEN_uniform();
+	}while(u <= 0.0);
+	v = GEN_uniform();
+	r = sqrt(-2.0 * log(u));
+	spare = r * sin(2.0 * M_PI * v);
+	has_spare = 1;
+	return r * cos(2.0 * M_PI * v);
+}
+
+/*==============================================
+FUNCTION: GEN_setBits
+INPUT: the message, the first bit (1-based, as in
+the Mode-S documents), the number of bits and the
+value
+OUTPUT: the message, passed by reference
+================================================*/
+static void GEN_setBits(uint8_t *msg, int first, int count, uint32_t value){
+	int i = 0;
+
+	for(i = 0; i < count; i++){
+		int pos = first - 1 + i;
+		if((value >> (count - 1 - i)) & 1){
+			msg[pos / 8] |= (uint8_t)(0x80 >> (pos % 8));
+		}
+	}
+}
+
+static void GEN_setParity(uint8_t *msg, int bits, uint32_t address){
+	GEN_setBits(msg, bits - 23, 24, CRC_checksum(msg, bits) ^ address);
+}
+
+/*==============================================
+FUNCTION: GEN_NL
+INPUT: a latitude
+OUTPUT: the number of CPR longitude zones
+================================================*/
+static int GEN_NL(double lat){
+	double a = 0;
+
+	lat = fabs(lat);
+	if(lat < 1e-9){
+		return 59;
+	}
+	if(lat > 87.0){
+		return (lat == 87.0) ? 2 : 1;
+	}
+	a = 1.0 - (1.0 - cos(M_PI / 30.0)) / pow(cos(M_PI / 180.0 * lat), 2);
+	return (int)floor(2.0 * M_PI / acos(a));
+}
+
+/*==============================================
+FUNCTION: GEN_cprEncode
+INPUT: a position, the frame parity (0 even, 1
+odd) and pointers to the encoded values
+OUTPUT: the 17-bit CPR latitude and longitude,
+passed by reference
+================================================*/
+static void GEN_cprEncode(double lat, double lon, int odd, uint32_t *yz, uint32_t *xz){
+	double dlat = 360.0 / (60 - odd);
+	double scale = 131072.0;
+	double y = floor(scale * fmod(fmod(lat, dlat) + dlat, dlat) / dlat + 0.5);
+	double rlat = dlat * (y / scale + floor(lat / dlat));
+	int nl = GEN_NL(rlat) - odd;
+	double dlon = 360.0 / ((nl > 1) ? nl : 1);
+	double x = floor(scale * fmod(fmod(lon, dlon) + dlon, dlon) / dlon + 0.5);
+
+	*yz = (uint32_t)y & 0x1FFFF;
+	*xz = (uint32_t)x & 0x1FFFF;
+}
+
+/*==============================================
+FUNCTION: GEN_altitude
+INPUT: an altitude in feet
+OUTPUT: the 11-bit 25-ft step code (Q bit = 1)
+================================================*/
+static uint32_t GEN_altitude(int feet){
+	int n = (feet + 1000) / 25;
+	return (uint32_t)((n < 0) ? 0 : (n > 2047) ? 2047 : n);
+}
+
+static const char callsign_chars[] = "#ABCDEFGHIJKLMNOPQRSTUVWXYZ##### ###############0123456789######";
+
+static uint32_t GEN_charCode(char c){
+	const char *p = strchr(callsign_chars, c);
+	return (p && c != '#') ? (uint32_t)(p - callsign_chars) : 32;
+}
+
+/*==============================================
+FUNCTION: GEN_buildFrame
+INPUT: a frame (with kind and aircraft set), the
+aircraft and the time in seconds
+OUTPUT: the frame bits, passed by reference
+DESCRIPTION: encodes the state of the aircraft at
+that time into the frame.
+================================================*/
+static void GEN_buildFrame(genFrame *f, genAircraft *a, double t){
+	double lat = a->lat + a->vn * t / 3600.0 / 60.0;
+	double lon = a->lon + a->ve * t / 3600.0 / 60.0 / cos(a->lat * M_PI / 180.0);
+	int altitude = a->altitude + (int)(a->vrate * t / 60.0);
+	uint32_t n = GEN_altitude(altitude);
+	uint8_t *m = f->msg;
+	int i = 0;
+
+	memset(m, 0, sizeof(f->msg));
+	switch(f->kind){
+		case KIND_ALLCALL:
+			f->bits = 56;
+			GEN_setBits(m, 1, 5, 11);
+			GEN_setBits(m, 6, 3, 5);
+			GEN_setBits(m, 9, 24, a->icao);
+			GEN_setParity(m, 56, 0);
+			return;
+
+		case KIND_ALTITUDE:
+			f->bits = 56;
+			GEN_setBits(m, 1, 5, 4);
+			//AC field: the 11-bit code around the M (0) and Q (1) bits
+			GEN_setBits(m, 20, 13, ((n & 0x7E0) << 2) | ((n & 0x010) << 1) | 0x10 | (n & 0x0F));
+			//AP: the parity overlaid with the address
+			GEN_setParity(m, 56, a->icao);
+			return;
+
+		default:
+			break;
+	}
+
+	f->bits = 112;
+	GEN_setBits(m, 1, 5, 17);
+	GEN_setBits(m, 6, 3, 5);
+	GEN_setBits(m, 9, 24, a->icao);
+
+	if(f->kind == KIND_IDENT){
+		GEN_setBits(m, 33, 5, 4);
+		for(i = 0; i < 8; i++){
+			GEN_setBits(m, 41 + 6*i, 6, GEN_charCode(a->callsign[i]));
+		}
+	}else if(f->kind == KIND_POSITION){
+		uint32_t yz = 0, xz = 0;
+
+		GEN_cprEncode(lat, lon, a->odd, &yz, &xz);
+		GEN_setBits(m, 33, 5, 11);
+		GEN_setBits(m, 41, 12, ((n & 0x7F0) << 1) | 0x10 | (n & 0x0F));
+		GEN_setBits(m, 54, 1, a->odd);
+		GEN_setBits(m, 55, 17, yz);
+		GEN_setBits(m, 72, 17, xz);
+		a->odd ^= 1;
+	}else{
+		int vew = (int)fabs(a->ve) + 1, vns = (int)fabs(a->vn) + 1;
+		int vr = abs(a->vrate) / 64 + 1;
+
+		GEN_setBits(m, 33, 5, 19);
+		GEN_setBits(m, 38, 3, 1);
+		GEN_setBits(m, 46, 1, a->ve < 0);
+		GEN_setBits(m, 47, 10, (vew > 1023) ? 1023 : vew);
+		GEN_setBits(m, 57, 1, a->vn < 0);
+		GEN_setBits(m, 58, 10, (vns > 1023) ? 1023 : vns);
+		GEN_setBits(m, 69, 1, a->vrate < 0);
+		GEN_setBits(m, 70, 9, (vr > 511) ? 511 : vr);
+	}
+	GEN_setParity(m, 112, 0);
+}
+
+/*==============================================
+FUNCTION: GEN_pickKind
+INPUT: void
+OUTPUT: a KIND_* value
+DESCRIPTION: mix of a busy terminal area: mostly
+extended squitters, plus all-call and altitude
+replies to the ground radars.
+================================================*/
+static int GEN_pickKind(void){
+	double u = GEN_uniform();
+
+	if(u < 0.10) return KIND_IDENT;
+	if(u < 0.40) return KIND_POSITION;
+	if(u < 0.60) return KIND_VELOCITY;
+	if(u < 0.80) return KIND_ALLCALL;
+	return KIND_ALTITUDE;
+}
+
+static void GEN_createAircraft(genAircraft *a){
+	static const char *airlines[] = {"GLO", "TAM", "AZU", "TAP", "AFR", "UAE"};
+	double bearing = 2.0 * M_PI * GEN_uniform();
+	double range = GEN_RANGE_KM * sqrt(GEN_uniform());
+	double speed = 120.0 + 400.0 * GEN_uniform();
+	double heading = 2.0 * M_PI * GEN_uniform();
+
+	a->icao = (uint32_t)(GEN_random() >> 40) & 0xFFFFFF;
+	snprintf(a->callsign, sizeof(a->callsign), "%s%04d ",
+	         airlines[GEN_random() % 6], (int)(GEN_random() % 10000));
+	a->lat = center_lat + range * cos(bearing) / 111.2;
+	a->lon = center_lon + range * sin(bearing) / (111.2 * cos(center_lat * M_PI / 180.0));
+	a->vn = speed * cos(heading);
+	a->ve = speed * sin(heading);
+	a->altitude = 1000 + 25 * (int)(GEN_random() % 1600);
+	a->vrate = 64 * ((int)(GEN_random() % 61) - 30);
+	a->snr = snr_min + (snr_max - snr_min) * GEN_uniform();
+	a->freq = max_freq * (2.0 * GEN_uniform() - 1.0);
+	a->odd = GEN_random() & 1;
+}
+
+static int GEN_compareFrames(const void *a, const void *b){
+	double sa = ((const genFrame*)a)->start, sb = ((const genFrame*)b)->start;
+	return (sa > sb) - (sa < sb);
+}
+
+/*==============================================
+FUNCTION: GEN_schedule
+INPUT: the aircraft and a pointer to the count of
+frames
+OUTPUT: the frames, sorted by start time
+DESCRIPTION: each aircraft transmits at random
+(Poisson) times with msg_rate frames per second.
+With probability 'overlap', a frame of another
+aircraft is also started inside it.
+================================================*/
+static genFrame* GEN_schedule(genAircraft *aircraft, int *count){
+	double span = duration * 1e6 - FRAME_US(112);
+	int capacity = 1024, n = 0, i = 0;
+	genFrame *frames = (genFrame*)malloc(capacity * sizeof(genFrame));
+
+	for(i = 0; (i < n_aircraft) && frames; i++){
+		double t = -log(1.0 - GEN_uniform()) / msg_rate * 1e6;
+
+		while(t < span){
+			int extra = (GEN_uniform() < overlap) && (n_aircraft > 1);
+			int k = 0;
+
+			if(n + 2 > capacity){
+				genFrame *grown = (genFrame*)realloc(frames, 2 * capacity * sizeof(genFrame));
+				if(grown == NULL){
+					free(frames);
+					return NULL;
+				}
+				frames = grown;
+				capacity *= 2;
+			}
+
+			for(k = 0; k <= extra; k++){
+				genFrame *f = &frames[n++];
+				f->aircraft = (k == 0) ? i : (i + 1 + (int)(GEN_random() % (n_aircraft - 1))) % n_aircraft;
+				f->kind = GEN_pickKind();
+				f->start = (k == 0) ? t : t + FRAME_US(112) * GEN_uniform();
+				if(f->start > span){
+					f->start = span;
+				}
+				if(aligned){
+					f->start = ceil(f->start * rate / 1e6) * 1e6 / rate;
+				}
+				f->overlapped = 0;
+			}
+			t += -log(1.0 - GEN_uniform()) / msg_rate * 1e6;
+		}
+	}
+	if(frames == NULL){
+		return NULL;
+	}
+
+	qsort(frames, n, sizeof(genFrame), GEN_compareFrames);
+
+	//The bits are built in time order, so the odd/even position frames alternate
+	for(i = 0; i < n; i++){
+		genAircraft *a = &aircraft[frames[i].aircraft];
+
+		GEN_buildFrame(&frames[i], a, frames[i].start / 1e6);
+		frames[i].amplitude = noise * sqrt(2.0) * pow(10.0, a->snr / 20.0);
+		frames[i].phase = 2.0 * M_PI * GEN_uniform();
+	}
+
+	//Overlap flags: a frame overlaps any frame that starts before it ends
+	double busy_until = -1.0;
+	int busy_frame = -1;
+	for(i = 0; i < n; i++){
+		if(frames[i].start < busy_until){
+			frames[i].overlapped = 1;
+			frames[busy_frame].overlapped = 1;
+		}
+		if(frames[i].start + FRAME_US(frames[i].bits) > busy_until){
+			busy_until = frames[i].start + FRAME_US(frames[i].bits);
+			busy_frame = i;
+		}
+	}
+
+	*count = n;
+	return frames;
+}
+
+/*==============================================
+FUNCTION: GEN_envelope
+INPUT: a frame and a time interval in us, relative
+to the frame start
+OUTPUT: the share of the interval during which the
+transmitter is on (0 to 1)
+DESCRIPTION: the preamble pulses are at 0, 1, 3.5
+and 4.5 us, each bit has its 0.5 us pulse in the
+first (1) or in the second half (0). Integrating over
+the sample interval models the receiver bandwidth
+and the sampling phase of any sample rate.
+================================================*/
+static double GEN_envelope(const genFrame *f, double from, double to){
+	static const double preamble[4] = {0.0, 1.0, 3.5, 4.5};
+	double on = 0.0, t = 0.0;
+	int i = 0;
+
+	for(t = floor(from * 2.0) / 2.0; t < to; t += 0.5){
+		double start = 0.0;
+		int pulse = 0;
+
+		if(t < 0.0){
+			continue;
+		}
+		if(t < PREAMBLE_US){
+			for(i = 0; i < 4; i++){
+				pulse |= (t == preamble[i]);
+			}
+		}else{
+			int bit = (int)(t - PREAMBLE_US);
+			int second_half = (t - PREAMBLE_US - bit) >= 0.5;
+
+			if(bit >= f->bits){
+				break;
+			}
+			pulse = ((f->msg[bit / 8] >> (7 - (bit % 8))) & 1) ^ second_half;
+		}
+		if(pulse){
+			start = (t > from) ? t : from;
+			on += ((t + 0.5 < to) ? t + 0.5 : to) - start;
+		}
+	}
+	return on / (to - from);
+}
+
+static uint8_t GEN_quantize(double v){
+	v = floor(v + 127.5 + 0.5);
+	return (uint8_t)((v < 0.0) ? 0 : (v > 255.0) ? 255 : v);
+}
+
+/*==============================================
+FUNCTION: GEN_synthesize
+INPUT: the frames, their count, the aircraft and the
+output file
+OUTPUT: 0 on success, -1 otherwise
+DESCRIPTION: writes the IQ samples block by block:
+gaussian noise plus every frame on the air, each one
+on its own carrier (frequency offset and phase).
+================================================*/
+static int GEN_synthesize(const genFrame *frames, int n, const genAircraft *aircraft, FILE *out){
+	long long total = (long long)(duration * rate);
+	long long first = 0;
+	double *iq = (double*)malloc(2 * GEN_BLOCK_SAMPLES * sizeof(double));
+	uint8_t *bytes = (uint8_t*)malloc(2 * GEN_BLOCK_SAMPLES);
+	double us_per_sample = 1e6 / rate;
+	int next = 0, i = 0;
+
+	if(!iq || !bytes){
+		free(iq);
+		free(bytes);
+		return -1;
+	}
+
+	for(first = 0; first < total; first += GEN_BLOCK_SAMPLES){
+		int len = (total - first < GEN_BLOCK_SAMPLES) ? (int)(total - first) : GEN_BLOCK_SAMPLES;
+		double block_start = first * us_per_sample;
+		double block_end = (first + len) * us_per_sample;
+
+		for(i = 0; i < 2 * len; i++){
+			iq[i] = noise * GEN_gaussian();
+		}
+
+		//frames are sorted by start; skip the ones that ended before this block
+		while((next < n) && (frames[next].start + FRAME_US(112) < block_start)){
+			next++;
+		}
+		for(i = next; (i < n) && (frames[i].start < block_end); i++){
+			const genFrame *f = &frames[i];
+			double omega = 2.0 * M_PI * aircraft[f->aircraft].freq / 1e6;
+			long long s0 = (long long)floor(f->start / us_per_sample);
+			long long s1 = (long long)ceil((f->start + FRAME_US(f->bits)) / us_per_sample);
+			long long s = 0;
+
+			if(s0 < first) s0 = first;
+			if(s1 > first + len) s1 = first + len;
+			for(s = s0; s < s1; s++){
+				double t = s * us_per_sample - f->start;
+				double a = f->amplitude * GEN_envelope(f, t, t + us_per_sample);
+
+				if(a > 0.0){
+					double phase = f->phase + omega * t;
+					iq[2*(s - first)]     += a * cos(phase);
+					iq[2*(s - first) + 1] += a * sin(phase);
+				}
+			}
+		}
+
+		for(i = 0; i < 2 * len; i++){
+			bytes[i] = GEN_quantize(iq[i]);
+		}
+		if(fwrite(bytes, 1, 2 * len, out) != (size_t)(2 * len)){
+			free(iq);
+			free(bytes);
+			return -1;
+		}
+	}
+
+	free(iq);
+	free(bytes);
+	return 0;
+}
+
+/*==============================================
+FUNCTION: GEN_writeTruth
+INPUT: the frames, their count, the aircraft and
+the CSV path
+OUTPUT: 0 on success, -1 otherwise
+DESCRIPTION: one line per frame, in time order. The
+hex column is what a perfect receiver decodes.
+================================================*/
+static int GEN_writeTruth(const genFrame *frames, int n, const genAircraft *aircraft, const char *path){
+	FILE *csv = fopen(path, "w");
+	int i = 0, j = 0;
+
+	if(csv == NULL){
+		perror(path);
+		return -1;
+	}
+	fprintf(csv, "sample,time_us,df,icao,hex,snr_db,freq_hz,overlapped\n");
+	for(i = 0; i < n; i++){
+		const genFrame *f = &frames[i];
+		const genAircraft *a = &aircraft[f->aircraft];
+
+		fprintf(csv, "%.2f,%.3f,%d,%06X,", f->start * rate / 1e6, f->start, f->msg[0] >> 3, a->icao);
+		for(j = 0; j < f->bits / 8; j++){
+			fprintf(csv, "%02X", f->msg[j]);
+		}
+		fprintf(csv, ",%.1f,%.0f,%d\n", a->snr, a->freq, f->overlapped);
+	}
+	return fclose(csv);
+}
+
+static void usage(const char *prog){
+	printf("Usage: %s [options] OUTPUT.cu8   (\"-\" writes to stdout)\n"
+	       "  -r, --rate SPS         sample rate (default %d)\n"
+	       "  -d, --duration S       seconds of signal (default %.0f)\n"
+	       "  -a, --aircraft N       number of aircraft (default %d)\n"
+	       "  -m, --msg-rate F       frames per second per aircraft (default %.1f)\n"
+	       "  -s, --snr MIN[:MAX]    SNR range of the aircraft in dB (default %.0f:%.0f)\n"
+	       "  -n, --noise RMS        noise RMS per IQ component, in 8-bit units (default %.1f)\n"
+	       "  -f, --freq-offset HZ   maximum carrier offset of the aircraft (default %.0f)\n"
+	       "  -o, --overlap P        probability of starting another frame inside a frame (default 0)\n"
+	       "  -c, --center LAT,LON   receiver position (default %.4f,%.4f)\n"
+	       "  -A, --aligned          start the frames on whole samples\n"
+	       "  -S, --seed N           random seed (default 1)\n"
+	       "  -t, --truth FILE       write the ground truth CSV\n"
+	       "  -h, --help             show this help\n",
+	       prog, GEN_DEFAULT_RATE, GEN_DEFAULT_DURATION, GEN_DEFAULT_AIRCRAFT, GEN_DEFAULT_MSG_RATE,
+	       GEN_DEFAULT_SNR_MIN, GEN_DEFAULT_SNR_MAX, GEN_DEFAULT_NOISE, GEN_DEFAULT_FREQ,
+	       GEN_DEFAULT_LAT, GEN_DEFAULT_LON);
+}
+
+int main(int argc, char **argv){
+	static const struct option long_options[] = {
+		{"rate",        required_argument, NULL, 'r'},
+		{"duration",    required_argument, NULL, 'd'},
+		{"aircraft",    required_argument, NULL, 'a'},
+		{"msg-rate",    required_argument, NULL, 'm'},
+		{"snr",         required_argument, NULL, 's'},
+		{"noise",       required_argument, NULL, 'n'},
+		{"freq-offset", required_argument, NULL, 'f'},
+		{"overlap",     required_argument, NULL, 'o'},
+		{"center",      required_argument, NULL, 'c'},
+		{"aligned",     no_argument,       NULL, 'A'},
+		{"seed",        required_argument, NULL, 'S'},
+		{"truth",       required_argument, NULL, 't'},
+		{"help",        no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	genAircraft *aircraft = NULL;
+	genFrame *frames = NULL;
+	FILE *out = NULL;
+	int opt = 0, n = 0, i = 0, overlapped = 0;
+
+	while((opt = getopt_long(argc, argv, "r:d:a:m:s:n:f:o:c:AS:t:h", long_options, NULL)) != -1){
+		switch(opt){
+			case 'r': rate = atof(optarg); break;
+			case 'd': duration = atof(optarg); break;
+			case 'a': n_aircraft = atoi(optarg); break;
+			case 'm': msg_rate = atof(optarg); break;
+			case 's':
+				if(sscanf(optarg, "%lf:%lf", &snr_min, &snr_max) < 2){
+					snr_max = snr_min;
+				}
+				break;
+			case 'n': noise = atof(optarg); break;
+			case 'f': max_freq = atof(optarg); break;
+			case 'o': overlap = atof(optarg); break;
+			case 'c': sscanf(optarg, "%lf,%lf", &center_lat, &center_lon); break;
+			case 'A': aligned = 1; break;
+			case 'S': seed = strtoull(optarg, NULL, 0); break;
+			case 't': truth_path = optarg; break;
+			default:
+				usage(argv[0]);
+				return (opt == 'h') ? 0 : 1;
+		}
+	}
+	if((optind != argc - 1) || (rate < 1e6) || (duration <= 0) || (n_aircraft < 1) || (msg_rate <= 0)){
+		usage(argv[0]);
+		return 1;
+	}
+
+	rng_state = seed ? seed : 1;
+	aircraft = (genAircraft*)calloc(n_aircraft, sizeof(genAircraft));
+	if(aircraft == NULL){
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+	for(i = 0; i < n_aircraft; i++){
+		GEN_createAircraft(&aircraft[i]);
+	}
+
+	frames = GEN_schedule(aircraft, &n);
+	if(frames == NULL){
+		fprintf(stderr, "Out of memory.\n");
+		free(aircraft);
+		return 1;
+	}
+
+	out = (strcmp(argv[optind], "-") == 0) ? stdout : fopen(argv[optind], "wb");
+	if(out == NULL){
+		perror(argv[optind]);
+		free(frames);
+		free(aircraft);
+		return 1;
+	}
+	if((GEN_synthesize(frames, n, aircraft, out) != 0) || ((out != stdout) && (fclose(out) != 0))){
+		fprintf(stderr, "Failed to write the samples.\n");
+		free(frames);
+		free(aircraft);
+		return 1;
+	}
+	if(truth_path && (GEN_writeTruth(frames, n, aircraft, truth_path) != 0)){
+		free(frames);
+		free(aircraft);
+		return 1;
+	}
+
+	for(i = 0; i < n; i++){
+		overlapped += frames[i].overlapped;
+	}
+	fprintf(stderr, "Generated %d frames from %d aircraft in %.1f s at %.0f S/s (%d overlapped).\n",
+	        n, n_aircraft, duration, rate, overlapped);
+
+	free(frames);
+	free(aircraft);
+	return 0;
+}